@@ -281,27 +281,40 @@ int SDL_main(int argc, char* argv[])
   win->addHandler([&](SvgGui*, SDL_Event* event){
     if(event->type == SDL_QUIT || (event->type == SDL_KEYDOWN && event->key.keysym.sym == SDLK_ESCAPE))
       runApplication = false;
-    else if(event->type == SDL_KEYDOWN && event->key.keysym.sym == SDLK_PRINTSCREEN)
+    else if(event->type == SDL_KEYDOWN && event->key.keysym.sym == SDLK_PRINTSCREEN) {
       SvgGui::debugLayout = true;
-    else if(event->type == SDL_KEYDOWN && event->key.keysym.sym == SDLK_F12)
+      gui->requestFrame();
+    }
+    else if(event->type == SDL_KEYDOWN && event->key.keysym.sym == SDLK_F12) {
       SvgGui::debugDirty = !SvgGui::debugDirty;
+      gui->requestFrame();
+    }
     return false;
   });
   gui->showWindow(win, NULL);
 
   while(runApplication) {
     int fbWidth = 0, fbHeight = 0;
+    // wait for events until a frame is due (timers wake us via timer thread), so that events arriving faster
+    //  than display refresh rate (e.g. pen input) are coalesced into a single frame
+    int timeout = gui->needsFrame() ? std::max(0, int(gui->nextDeadline() - mSecSinceEpoch())) : -1;
 #ifdef USE_GLFW
-    glfwWaitEvents();
+    if(timeout < 0)
+      glfwWaitEvents();
+    else
+      glfwWaitEventsTimeout(timeout/1000.0);
     std::function<void()> queuedFn;
     while(taskQueue.pop_front(queuedFn)) { queuedFn(); }
     glfwGetFramebufferSize(glfwWin, &fbWidth, &fbHeight);
 #else
     SDL_Event event;
-    SDL_WaitEvent(&event);
-    do { gui->sdlEvent(&event); } while(runApplication && SDL_PollEvent(&event));
+    if(SDL_WaitEventTimeout(&event, timeout)) {
+      do { gui->sdlEvent(&event); } while(runApplication && SDL_PollEvent(&event));
+    }
     SDL_GL_GetDrawableSize(sdlWindow, &fbWidth, &fbHeight);
 #endif
+    if(!gui->needsFrame() || gui->nextDeadline() > mSecSinceEpoch())
+      continue;
 
     painter->deviceRect = Rect::wh(fbWidth, fbHeight);
     Rect dirty = gui->layoutAndDraw(painter);
@@ -101,6 +101,9 @@ typedef struct lay_context {
     lay_vec4 *rects;
     lay_id capacity;
     lay_id count;
+#ifdef LAY_SOA
+    struct lay_soa_t *soa; // scratch arrays for the structure-of-arrays backend
+#endif
 } lay_context;
 
 // Container flags to pass to lay_set_container()
@@ -428,7 +431,8 @@ LAY_STATIC_INLINE void lay_get_rect_xywh(
 // Notes about the use of vector_size merely for syntax convenience:
 //
 // The current layout calculation procedures are not written in a way that
-// would benefit from SIMD instruction usage.
+// would benefit from SIMD instruction usage. See LAY_SOA below for an
+// alternative implementation that does.
 //
 // (Passing 128-bit float4 vectors using __vectorcall *might* get you some
 // small benefit in very specific situations, but is unlikely to be worth the
@@ -445,6 +449,7 @@ LAY_STATIC_INLINE void lay_get_rect_xywh(
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <string.h> // memmove
 
 // Users of this library can define LAY_REALLOC to use a custom (re)allocator
 // instead of stdlib's realloc. It should have the same behavior as realloc --
@@ -493,22 +498,42 @@ static LAY_FORCE_INLINE float lay_float_max(float a, float b)
 static LAY_FORCE_INLINE float lay_float_min(float a, float b)
 { return a < b ? a : b; }
 
+#ifdef LAY_SOA
+static void lay_soa_free(lay_context *ctx);
+#endif
+
 void lay_init_context(lay_context *ctx)
 {
     ctx->capacity = 0;
     ctx->count = 0;
     ctx->items = NULL;
     ctx->rects = NULL;
+#ifdef LAY_SOA
+    ctx->soa = NULL;
+#endif
+}
+
+// rects are stored after items in the same block, so after a realloc the existing rects are still at
+// their old offset (i.e., after old_capacity items) and must be moved to follow the new capacity; this
+// only matters if rects are read before the next run (e.g. for a context kept across frames)
+static void lay_move_rects(lay_context *ctx, lay_id count, lay_id old_capacity)
+{
+    if (count > 0 && old_capacity > 0) {
+        const lay_vec4 *old_rects = (const lay_vec4*)(ctx->items + old_capacity);
+        memmove(ctx->rects, old_rects, count * sizeof(lay_vec4));
+    }
 }
 
 void lay_reserve_items_capacity(lay_context *ctx, lay_id count)
 {
     if (count >= ctx->capacity) {
+        lay_id old_capacity = ctx->capacity;
         ctx->capacity = count;
         const size_t item_size = sizeof(lay_item_t) + sizeof(lay_vec4);
         ctx->items = (lay_item_t*)LAY_REALLOC(ctx->items, ctx->capacity * item_size);
         const lay_item_t *past_last = ctx->items + ctx->capacity;
         ctx->rects = (lay_vec4*)past_last;
+        lay_move_rects(ctx, ctx->count, old_capacity);
     }
 }
 
@@ -519,13 +544,20 @@ void lay_destroy_context(lay_context *ctx)
         ctx->items = NULL;
         ctx->rects = NULL;
     }
+#ifdef LAY_SOA
+    lay_soa_free(ctx);
+#endif
 }
 
 void lay_reset_context(lay_context *ctx)
 { ctx->count = 0; }
 
+#ifdef LAY_SOA
+static void lay_soa_run_item(lay_context *ctx, lay_id item);
+#else
 static void lay_calc_size(lay_context *ctx, lay_id item, int dim);
 static void lay_arrange(lay_context *ctx, lay_id item, int dim);
+#endif
 
 void lay_run_context(lay_context *ctx)
 {
@@ -540,10 +572,14 @@ void lay_run_item(lay_context *ctx, lay_id item)
 {
     LAY_ASSERT(ctx != NULL);
 
+#ifdef LAY_SOA
+    lay_soa_run_item(ctx, item);
+#else
     lay_calc_size(ctx, item, 0);
     lay_arrange(ctx, item, 0);
     lay_calc_size(ctx, item, 1);
     lay_arrange(ctx, item, 1);
+#endif
 }
 
 // Alternatively, we could use a flag bit to indicate whether an item's children
@@ -574,11 +610,13 @@ lay_id lay_item(lay_context *ctx)
     lay_id idx = ctx->count++;
 
     if (idx >= ctx->capacity) {
+        lay_id old_capacity = ctx->capacity;
         ctx->capacity = ctx->capacity < 1 ? 32 : (ctx->capacity * 4);
         const size_t item_size = sizeof(lay_item_t) + sizeof(lay_vec4);
         ctx->items = (lay_item_t*)LAY_REALLOC(ctx->items, ctx->capacity * item_size);
         const lay_item_t *past_last = ctx->items + ctx->capacity;
         ctx->rects = (lay_vec4*)past_last;
+        lay_move_rects(ctx, idx, old_capacity);
     }
 
     lay_item_t *item = lay_get_item(ctx, idx);
@@ -765,6 +803,8 @@ void lay_get_margins_ltrb(
     *b = margins[3];
 }
 
+#ifndef LAY_SOA
+
 // TODO restrict item ptrs correctly
 static LAY_FORCE_INLINE
 lay_scalar lay_calc_overlayed_size(
@@ -1190,4 +1230,617 @@ static void lay_arrange(lay_context *ctx, lay_id item, int dim)
     }
 }
 
+#else // LAY_SOA
+
+// Structure-of-arrays backend, enabled by defining LAY_SOA: lay_run_item()
+// copies the subtree into arrays indexed by "slot", with the children of each
+// item in consecutive slots (breadth-first order), runs the layout procedures
+// over these contiguous sibling ranges, then copies rects and flags back. The
+// per-child work in calc_stacked_size, calc_overlayed_size, arrange_overlay,
+// arrange_overlay_squeezed_range and the first pass of arrange_stacked is done
+// 4 children at a time with SSE2 or NEON when LAY_FLOAT is set (define
+// LAY_NO_SIMD to use the scalar loops only). Sums along the stacking direction
+// are still accumulated one child at a time in the original order, so results
+// are identical to the linked-list implementation above.
+
+#if defined(LAY_FLOAT) && !defined(LAY_NO_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LAY_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LAY_SIMD_NEON
+#endif
+#endif
+
+typedef struct lay_soa_t {
+    lay_id capacity;
+    lay_id count;
+    void *block;
+    lay_id *item; // item id for each slot
+    lay_id *first; // slot of first child
+    lay_id *nchildren;
+    uint32_t *flags;
+    lay_scalar *margins[4];
+    lay_scalar *size[2];
+    lay_scalar *rect[4];
+} lay_soa_t;
+
+#if defined(LAY_SIMD_SSE2)
+#define LAY_SIMD
+typedef __m128 lay_f4;
+typedef __m128 lay_m4;
+static LAY_FORCE_INLINE lay_f4 lay_f4_load(const float *p) { return _mm_loadu_ps(p); }
+static LAY_FORCE_INLINE void lay_f4_store(float *p, lay_f4 v) { _mm_storeu_ps(p, v); }
+static LAY_FORCE_INLINE lay_f4 lay_f4_set1(float x) { return _mm_set1_ps(x); }
+static LAY_FORCE_INLINE lay_f4 lay_f4_add(lay_f4 a, lay_f4 b) { return _mm_add_ps(a, b); }
+static LAY_FORCE_INLINE lay_f4 lay_f4_sub(lay_f4 a, lay_f4 b) { return _mm_sub_ps(a, b); }
+static LAY_FORCE_INLINE lay_f4 lay_f4_mul(lay_f4 a, lay_f4 b) { return _mm_mul_ps(a, b); }
+// same as lay_scalar_max/min: a > b ? a : b and a < b ? a : b
+static LAY_FORCE_INLINE lay_f4 lay_f4_max(lay_f4 a, lay_f4 b) { return _mm_max_ps(a, b); }
+static LAY_FORCE_INLINE lay_f4 lay_f4_min(lay_f4 a, lay_f4 b) { return _mm_min_ps(a, b); }
+static LAY_FORCE_INLINE lay_f4 lay_f4_select(lay_m4 m, lay_f4 a, lay_f4 b)
+{ return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+// lanes where (flags & mask) == value
+static LAY_FORCE_INLINE lay_m4 lay_m4_flags(const uint32_t *flags, uint32_t mask, uint32_t value)
+{
+    __m128i f = _mm_loadu_si128((const __m128i*)flags);
+    f = _mm_and_si128(f, _mm_set1_epi32((int)mask));
+    return _mm_castsi128_ps(_mm_cmpeq_epi32(f, _mm_set1_epi32((int)value)));
+}
+// ~a & b
+static LAY_FORCE_INLINE lay_m4 lay_m4_andnot(lay_m4 a, lay_m4 b) { return _mm_andnot_ps(a, b); }
+static LAY_FORCE_INLINE uint32_t lay_m4_count(lay_m4 m)
+{
+    int bits = _mm_movemask_ps(m);
+    return (bits & 1) + ((bits >> 1) & 1) + ((bits >> 2) & 1) + ((bits >> 3) & 1);
+}
+#elif defined(LAY_SIMD_NEON)
+#define LAY_SIMD
+typedef float32x4_t lay_f4;
+typedef uint32x4_t lay_m4;
+static LAY_FORCE_INLINE lay_f4 lay_f4_load(const float *p) { return vld1q_f32(p); }
+static LAY_FORCE_INLINE void lay_f4_store(float *p, lay_f4 v) { vst1q_f32(p, v); }
+static LAY_FORCE_INLINE lay_f4 lay_f4_set1(float x) { return vdupq_n_f32(x); }
+static LAY_FORCE_INLINE lay_f4 lay_f4_add(lay_f4 a, lay_f4 b) { return vaddq_f32(a, b); }
+static LAY_FORCE_INLINE lay_f4 lay_f4_sub(lay_f4 a, lay_f4 b) { return vsubq_f32(a, b); }
+static LAY_FORCE_INLINE lay_f4 lay_f4_mul(lay_f4 a, lay_f4 b) { return vmulq_f32(a, b); }
+// vmaxq_f32/vminq_f32 differ from lay_scalar_max/min for signed zeros, so use compare and select
+static LAY_FORCE_INLINE lay_f4 lay_f4_max(lay_f4 a, lay_f4 b) { return vbslq_f32(vcgtq_f32(a, b), a, b); }
+static LAY_FORCE_INLINE lay_f4 lay_f4_min(lay_f4 a, lay_f4 b) { return vbslq_f32(vcltq_f32(a, b), a, b); }
+static LAY_FORCE_INLINE lay_f4 lay_f4_select(lay_m4 m, lay_f4 a, lay_f4 b) { return vbslq_f32(m, a, b); }
+static LAY_FORCE_INLINE lay_m4 lay_m4_flags(const uint32_t *flags, uint32_t mask, uint32_t value)
+{ return vceqq_u32(vandq_u32(vld1q_u32(flags), vdupq_n_u32(mask)), vdupq_n_u32(value)); }
+static LAY_FORCE_INLINE lay_m4 lay_m4_andnot(lay_m4 a, lay_m4 b) { return vbicq_u32(b, a); }
+static LAY_FORCE_INLINE uint32_t lay_m4_count(lay_m4 m)
+{
+    uint32_t lanes[4];
+    vst1q_u32(lanes, vshrq_n_u32(m, 31));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+#endif
+
+static lay_soa_t *lay_soa_reserve(lay_context *ctx, lay_id count)
+{
+    lay_soa_t *a = ctx->soa;
+    if (a == NULL) {
+        a = (lay_soa_t*)LAY_REALLOC(NULL, sizeof(lay_soa_t));
+        LAY_MEMSET(a, 0, sizeof(lay_soa_t));
+        ctx->soa = a;
+    }
+    if (count > a->capacity) {
+        lay_id cap = a->capacity < 32 ? 32 : a->capacity;
+        while (cap < count)
+            cap *= 2;
+        // 4 id/flag arrays followed by 10 scalar arrays
+        const size_t slot_size = 4 * sizeof(uint32_t) + 10 * sizeof(lay_scalar);
+        a->block = LAY_REALLOC(a->block, cap * slot_size);
+        a->capacity = cap;
+        uint32_t *p = (uint32_t*)a->block;
+        a->item = p; p += cap;
+        a->first = p; p += cap;
+        a->nchildren = p; p += cap;
+        a->flags = p; p += cap;
+        lay_scalar *s = (lay_scalar*)p;
+        for (int k = 0; k < 4; ++k) { a->margins[k] = s; s += cap; }
+        for (int k = 0; k < 2; ++k) { a->size[k] = s; s += cap; }
+        for (int k = 0; k < 4; ++k) { a->rect[k] = s; s += cap; }
+    }
+    return a;
+}
+
+static void lay_soa_free(lay_context *ctx)
+{
+    if (ctx->soa != NULL) {
+        if (ctx->soa->block != NULL)
+            LAY_FREE(ctx->soa->block);
+        LAY_FREE(ctx->soa);
+        ctx->soa = NULL;
+    }
+}
+
+// copy subtree rooted at item into slots, breadth-first so siblings are contiguous
+static lay_soa_t *lay_soa_load(lay_context *ctx, lay_id item)
+{
+    lay_soa_t *a = lay_soa_reserve(ctx, ctx->count);
+    lay_id n = 1;
+    a->item[0] = item;
+    for (lay_id s = 0; s < n; ++s) {
+        const lay_item_t *pitem = lay_get_item(ctx, a->item[s]);
+        a->first[s] = n;
+        lay_id child = pitem->first_child;
+        while (child != LAY_INVALID_ID) {
+            LAY_ASSERT(n < a->capacity);
+            a->item[n++] = child;
+            child = ctx->items[child].next_sibling;
+        }
+        a->nchildren[s] = n - a->first[s];
+        a->flags[s] = pitem->flags;
+        for (int k = 0; k < 4; ++k)
+            a->margins[k][s] = pitem->margins[k];
+        a->size[0][s] = pitem->size[0];
+        a->size[1][s] = pitem->size[1];
+    }
+    a->count = n;
+    return a;
+}
+
+static void lay_soa_store(lay_context *ctx, const lay_soa_t *a)
+{
+    for (lay_id s = 0; s < a->count; ++s) {
+        lay_id id = a->item[s];
+        ctx->items[id].flags = a->flags[s];
+        lay_vec4 rect;
+        for (int k = 0; k < 4; ++k)
+            rect[k] = a->rect[k][s];
+        ctx->rects[id] = rect;
+    }
+}
+
+static LAY_FORCE_INLINE
+lay_scalar lay_soa_calc_overlayed_size(const lay_soa_t *a, lay_id item, int dim)
+{
+    const lay_scalar *pos = a->rect[dim], *size = a->rect[2 + dim], *mend = a->margins[2 + dim];
+    const lay_id end = a->first[item] + a->nchildren[item];
+    lay_scalar need_size = 0;
+    lay_id i = a->first[item];
+#ifdef LAY_SIMD
+    if (i + 4 <= end) {
+        lay_f4 need4 = lay_f4_set1(0);
+        for (; i + 4 <= end; i += 4) {
+            lay_f4 child_size = lay_f4_add(lay_f4_add(lay_f4_load(pos + i), lay_f4_load(size + i)), lay_f4_load(mend + i));
+            need4 = lay_f4_max(need4, child_size);
+        }
+        float lanes[4];
+        lay_f4_store(lanes, need4);
+        for (int k = 0; k < 4; ++k)
+            need_size = lay_scalar_max(need_size, lanes[k]);
+    }
+#endif
+    for (; i < end; ++i)
+        need_size = lay_scalar_max(need_size, pos[i] + size[i] + mend[i]);
+    return need_size;
+}
+
+static LAY_FORCE_INLINE
+lay_scalar lay_soa_calc_stacked_size(const lay_soa_t *a, lay_id item, int dim)
+{
+    const lay_scalar *pos = a->rect[dim], *size = a->rect[2 + dim], *mend = a->margins[2 + dim];
+    const lay_id end = a->first[item] + a->nchildren[item];
+    lay_scalar need_size = 0;
+    lay_id i = a->first[item];
+#ifdef LAY_SIMD
+    for (; i + 4 <= end; i += 4) {
+        float lanes[4];
+        lay_f4_store(lanes, lay_f4_add(lay_f4_add(lay_f4_load(pos + i), lay_f4_load(size + i)), lay_f4_load(mend + i)));
+        // accumulate in order to match scalar result
+        need_size += lanes[0];
+        need_size += lanes[1];
+        need_size += lanes[2];
+        need_size += lanes[3];
+    }
+#endif
+    for (; i < end; ++i)
+        need_size += pos[i] + size[i] + mend[i];
+    return need_size;
+}
+
+static LAY_FORCE_INLINE
+lay_scalar lay_soa_calc_wrapped_overlayed_size(const lay_soa_t *a, lay_id item, int dim)
+{
+    const lay_scalar *pos = a->rect[dim], *size = a->rect[2 + dim], *mend = a->margins[2 + dim];
+    const lay_id end = a->first[item] + a->nchildren[item];
+    lay_scalar need_size = 0;
+    lay_scalar need_size2 = 0;
+    for (lay_id i = a->first[item]; i < end; ++i) {
+        if (a->flags[i] & LAY_BREAK) {
+            need_size2 += need_size;
+            need_size = 0;
+        }
+        lay_scalar child_size = pos[i] + size[i] + mend[i];
+        need_size = lay_scalar_max(need_size, child_size);
+    }
+    return need_size2 + need_size;
+}
+
+static LAY_FORCE_INLINE
+lay_scalar lay_soa_calc_wrapped_stacked_size(const lay_soa_t *a, lay_id item, int dim)
+{
+    const lay_scalar *pos = a->rect[dim], *size = a->rect[2 + dim], *mend = a->margins[2 + dim];
+    const lay_id end = a->first[item] + a->nchildren[item];
+    lay_scalar need_size = 0;
+    lay_scalar need_size2 = 0;
+    for (lay_id i = a->first[item]; i < end; ++i) {
+        if (a->flags[i] & LAY_BREAK) {
+            need_size2 = lay_scalar_max(need_size2, need_size);
+            need_size = 0;
+        }
+        need_size += pos[i] + size[i] + mend[i];
+    }
+    return lay_scalar_max(need_size2, need_size);
+}
+
+static void lay_soa_calc_size(lay_soa_t *a, lay_id item, int dim)
+{
+    const lay_id end = a->first[item] + a->nchildren[item];
+    for (lay_id child = a->first[item]; child < end; ++child)
+        lay_soa_calc_size(a, child, dim);
+
+    a->rect[dim][item] = a->margins[dim][item];
+
+    if (a->size[dim][item] != 0) {
+        a->rect[2 + dim][item] = a->size[dim][item];
+        return;
+    }
+
+    const uint32_t flags = a->flags[item];
+    lay_scalar cal_size;
+    switch (flags & LAY_ITEM_BOX_MODEL_MASK) {
+    case LAY_COLUMN|LAY_WRAP:
+        if (dim)
+            cal_size = lay_soa_calc_stacked_size(a, item, 1);
+        else
+            cal_size = lay_soa_calc_overlayed_size(a, item, 0);
+        break;
+    case LAY_ROW|LAY_WRAP:
+        if (!dim)
+            cal_size = lay_soa_calc_wrapped_stacked_size(a, item, 0);
+        else
+            cal_size = lay_soa_calc_wrapped_overlayed_size(a, item, 1);
+        break;
+    case LAY_COLUMN:
+    case LAY_ROW:
+        if ((flags & 1) == (uint32_t)dim)
+            cal_size = lay_soa_calc_stacked_size(a, item, dim);
+        else
+            cal_size = lay_soa_calc_overlayed_size(a, item, dim);
+        break;
+    default:
+        cal_size = lay_soa_calc_overlayed_size(a, item, dim);
+        break;
+    }
+    a->rect[2 + dim][item] = cal_size;
+}
+
+// first pass of lay_soa_arrange_stacked for the non-wrapping case
+static LAY_FORCE_INLINE
+lay_scalar lay_soa_stacked_used(const lay_soa_t *a, lay_id start, lay_id end, int dim,
+        uint32_t *count, uint32_t *squeezed_count)
+{
+    const lay_scalar *pos = a->rect[dim], *size = a->rect[2 + dim], *mend = a->margins[2 + dim];
+    const uint32_t *flags = a->flags;
+    const uint32_t fill = (uint32_t)LAY_HFILL << dim;
+    const uint32_t fixed = (uint32_t)LAY_ITEM_HFIXED << dim;
+    lay_scalar used = 0;
+    lay_id i = start;
+#ifdef LAY_SIMD
+    const lay_f4 zero = lay_f4_set1(0);
+    for (; i + 4 <= end; i += 4) {
+        lay_m4 isfill = lay_m4_flags(flags + i, fill, fill);
+        lay_m4 squeezed = lay_m4_andnot(isfill, lay_m4_flags(flags + i, fixed, 0));
+        *count += lay_m4_count(isfill);
+        *squeezed_count += lay_m4_count(squeezed);
+        // fillers only contribute margins
+        lay_f4 s = lay_f4_select(isfill, zero, lay_f4_load(size + i));
+        float lanes[4];
+        lay_f4_store(lanes, lay_f4_add(lay_f4_add(lay_f4_load(pos + i), s), lay_f4_load(mend + i)));
+        used += lanes[0];
+        used += lanes[1];
+        used += lanes[2];
+        used += lanes[3];
+    }
+#endif
+    for (; i < end; ++i) {
+        if ((flags[i] & fill) == fill) {
+            ++*count;
+            used += pos[i] + mend[i];
+        } else {
+            if (!(flags[i] & fixed))
+                ++*squeezed_count;
+            used += pos[i] + size[i] + mend[i];
+        }
+    }
+    return used;
+}
+
+static LAY_FORCE_INLINE
+void lay_soa_arrange_stacked(lay_soa_t *a, lay_id item, int dim, bool wrap)
+{
+    const int wdim = dim + 2;
+    lay_scalar *pos = a->rect[dim], *size = a->rect[2 + dim];
+    const lay_scalar *mend = a->margins[wdim];
+    const uint32_t item_flags = a->flags[item];
+    const lay_scalar space = size[item];
+    const float max_x2 = (float)(pos[item] + space);
+    const lay_id end = a->first[item] + a->nchildren[item];
+
+    lay_id start_child = a->first[item];
+    while (start_child < end) {
+        lay_scalar used = 0;
+        uint32_t count = 0; // count of fillers
+        uint32_t squeezed_count = 0; // count of squeezable elements
+        uint32_t total = 0;
+        bool hardbreak = false;
+        lay_id end_child = end;
+        if (!wrap) {
+            used = lay_soa_stacked_used(a, start_child, end, dim, &count, &squeezed_count);
+            total = end - start_child;
+        } else {
+            for (lay_id child = start_child; child < end; ++child) {
+                const uint32_t child_flags = a->flags[child];
+                const uint32_t flags = (child_flags & LAY_ITEM_LAYOUT_MASK) >> dim;
+                const uint32_t fflags = (child_flags & LAY_ITEM_FIXED_MASK) >> dim;
+                lay_scalar extend = used;
+                if ((flags & LAY_HFILL) == LAY_HFILL) {
+                    ++count;
+                    extend += pos[child] + mend[child];
+                } else {
+                    if ((fflags & LAY_ITEM_HFIXED) != LAY_ITEM_HFIXED)
+                        ++squeezed_count;
+                    extend += pos[child] + size[child] + mend[child];
+                }
+                if (total && ((extend > space) || (child_flags & LAY_BREAK))) {
+                    end_child = child;
+                    hardbreak = (child_flags & LAY_BREAK) == LAY_BREAK;
+                    a->flags[child] = child_flags | LAY_BREAK;
+                    break;
+                }
+                used = extend;
+                ++total;
+            }
+        }
+
+        lay_scalar extra_space = space - used;
+        float filler = 0.0f;
+        float spacer = 0.0f;
+        float extra_margin = 0.0f;
+        float eater = 0.0f;
+
+        if (extra_space > 0) {
+            if (count > 0)
+                filler = (float)extra_space / (float)count;
+            else if (total > 0) {
+                switch (item_flags & LAY_JUSTIFY) {
+                case LAY_JUSTIFY:
+                    if (!wrap || ((end_child != end) && !hardbreak))
+                        spacer = (float)extra_space / (float)(total - 1);
+                    break;
+                case LAY_START:
+                    break;
+                case LAY_END:
+                    extra_margin = extra_space;
+                    break;
+                default:
+                    extra_margin = extra_space / 2.0f;
+                    break;
+                }
+            }
+        }
+#ifdef LAY_FLOAT
+        else if (!wrap && (squeezed_count > 0))
+#else
+        else if (!wrap && (extra_space < 0))
+#endif
+            eater = (float)extra_space / (float)squeezed_count;
+
+        float x = (float)pos[item];
+        float x1;
+        for (lay_id child = start_child; child != end_child; ++child) {
+            lay_scalar ix0, ix1;
+            const uint32_t child_flags = a->flags[child];
+            const uint32_t flags = (child_flags & LAY_ITEM_LAYOUT_MASK) >> dim;
+            const uint32_t fflags = (child_flags & LAY_ITEM_FIXED_MASK) >> dim;
+
+            x += (float)pos[child] + extra_margin;
+            if ((flags & LAY_HFILL) == LAY_HFILL) // grow
+                x1 = x + filler;
+            else if ((fflags & LAY_ITEM_HFIXED) == LAY_ITEM_HFIXED)
+                x1 = x + (float)size[child];
+            else // squeeze
+                x1 = x + lay_float_max(0.0f, (float)size[child] + eater);
+
+            ix0 = (lay_scalar)x;
+            if (wrap)
+                ix1 = (lay_scalar)lay_float_min(max_x2 - (float)mend[child], x1);
+            else
+                ix1 = (lay_scalar)x1;
+            pos[child] = ix0;
+            size[child] = ix1 - ix0;
+            x = x1 + (float)mend[child];
+            extra_margin = spacer;
+        }
+
+        start_child = end_child;
+    }
+}
+
+static LAY_FORCE_INLINE
+void lay_soa_arrange_overlay(lay_soa_t *a, lay_id item, int dim)
+{
+    lay_scalar *pos = a->rect[dim], *size = a->rect[2 + dim];
+    const lay_scalar *mstart = a->margins[dim], *mend = a->margins[2 + dim];
+    const uint32_t *flags = a->flags;
+    const lay_scalar offset = pos[item];
+    const lay_scalar space = size[item];
+    const lay_id end = a->first[item] + a->nchildren[item];
+    lay_id i = a->first[item];
+#ifdef LAY_SIMD
+    const uint32_t fill = (uint32_t)LAY_HFILL << dim;
+    const uint32_t right = (uint32_t)LAY_RIGHT << dim;
+    const lay_f4 zero = lay_f4_set1(0), half = lay_f4_set1(0.5f);
+    const lay_f4 space4 = lay_f4_set1(space), offset4 = lay_f4_set1(offset);
+    for (; i + 4 <= end; i += 4) {
+        lay_f4 p = lay_f4_load(pos + i), s = lay_f4_load(size + i);
+        lay_f4 me = lay_f4_load(mend + i);
+        lay_f4 free4 = lay_f4_sub(space4, s);
+        lay_f4 pcenter = lay_f4_add(p, lay_f4_sub(lay_f4_mul(free4, half), me));
+        lay_f4 pright = lay_f4_add(p, lay_f4_sub(lay_f4_sub(free4, lay_f4_load(mstart + i)), me));
+        lay_f4 sfill = lay_f4_max(zero, lay_f4_sub(lay_f4_sub(space4, p), me));
+        p = lay_f4_select(lay_m4_flags(flags + i, fill, 0), pcenter, p);
+        p = lay_f4_select(lay_m4_flags(flags + i, fill, right), pright, p);
+        s = lay_f4_select(lay_m4_flags(flags + i, fill, fill), sfill, s);
+        lay_f4_store(pos + i, lay_f4_add(p, offset4));
+        lay_f4_store(size + i, s);
+    }
+#endif
+    for (; i < end; ++i) {
+        const uint32_t b_flags = (flags[i] & LAY_ITEM_LAYOUT_MASK) >> dim;
+        switch (b_flags & LAY_HFILL) {
+        case LAY_HCENTER:
+            pos[i] += (space - size[i]) / 2 - mend[i];
+            break;
+        case LAY_RIGHT:
+            pos[i] += space - size[i] - mstart[i] - mend[i];
+            break;
+        case LAY_HFILL:
+            size[i] = lay_scalar_max(0, space - pos[i] - mend[i]);
+            break;
+        default:
+            break;
+        }
+        pos[i] += offset;
+    }
+}
+
+static LAY_FORCE_INLINE
+void lay_soa_arrange_overlay_squeezed_range(lay_soa_t *a, int dim,
+        lay_id start_item, lay_id end_item, lay_scalar offset, lay_scalar space)
+{
+    lay_scalar *pos = a->rect[dim], *size = a->rect[2 + dim];
+    const lay_scalar *mend = a->margins[2 + dim];
+    const uint32_t *flags = a->flags;
+    lay_id i = start_item;
+#ifdef LAY_SIMD
+    const uint32_t fill = (uint32_t)LAY_HFILL << dim;
+    const uint32_t right = (uint32_t)LAY_RIGHT << dim;
+    const lay_f4 zero = lay_f4_set1(0), half = lay_f4_set1(0.5f);
+    const lay_f4 space4 = lay_f4_set1(space), offset4 = lay_f4_set1(offset);
+    for (; i + 4 <= end_item; i += 4) {
+        lay_f4 p = lay_f4_load(pos + i), s = lay_f4_load(size + i);
+        lay_f4 me = lay_f4_load(mend + i);
+        lay_f4 min_size = lay_f4_max(zero, lay_f4_sub(lay_f4_sub(space4, p), me));
+        lay_m4 isfill = lay_m4_flags(flags + i, fill, fill);
+        s = lay_f4_select(isfill, min_size, lay_f4_min(s, min_size));
+        lay_f4 free4 = lay_f4_sub(space4, s);
+        lay_f4 pcenter = lay_f4_add(p, lay_f4_sub(lay_f4_mul(free4, half), me));
+        lay_f4 pright = lay_f4_sub(free4, me);
+        p = lay_f4_select(lay_m4_flags(flags + i, fill, 0), pcenter, p);
+        p = lay_f4_select(lay_m4_flags(flags + i, fill, right), pright, p);
+        lay_f4_store(pos + i, lay_f4_add(p, offset4));
+        lay_f4_store(size + i, s);
+    }
+#endif
+    for (; i < end_item; ++i) {
+        const uint32_t b_flags = (flags[i] & LAY_ITEM_LAYOUT_MASK) >> dim;
+        lay_scalar min_size = lay_scalar_max(0, space - pos[i] - mend[i]);
+        switch (b_flags & LAY_HFILL) {
+        case LAY_HCENTER:
+            size[i] = lay_scalar_min(size[i], min_size);
+            pos[i] += (space - size[i]) / 2 - mend[i];
+            break;
+        case LAY_RIGHT:
+            size[i] = lay_scalar_min(size[i], min_size);
+            pos[i] = space - size[i] - mend[i];
+            break;
+        case LAY_HFILL:
+            size[i] = min_size;
+            break;
+        default:
+            size[i] = lay_scalar_min(size[i], min_size);
+            break;
+        }
+        pos[i] += offset;
+    }
+}
+
+static LAY_FORCE_INLINE
+lay_scalar lay_soa_arrange_wrapped_overlay_squeezed(lay_soa_t *a, lay_id item, int dim)
+{
+    const lay_scalar *pos = a->rect[dim], *size = a->rect[2 + dim], *mend = a->margins[2 + dim];
+    lay_scalar offset = pos[item];
+    lay_scalar need_size = 0;
+    const lay_id end = a->first[item] + a->nchildren[item];
+    lay_id start_child = a->first[item];
+    for (lay_id child = start_child; child < end; ++child) {
+        if (a->flags[child] & LAY_BREAK) {
+            lay_soa_arrange_overlay_squeezed_range(a, dim, start_child, child, offset, need_size);
+            offset += need_size;
+            start_child = child;
+            need_size = 0;
+        }
+        lay_scalar child_size = pos[child] + size[child] + mend[child];
+        need_size = lay_scalar_max(need_size, child_size);
+    }
+    lay_soa_arrange_overlay_squeezed_range(a, dim, start_child, end, offset, need_size);
+    offset += need_size;
+    return offset;
+}
+
+static void lay_soa_arrange(lay_soa_t *a, lay_id item, int dim)
+{
+    const uint32_t flags = a->flags[item];
+    switch (flags & LAY_ITEM_BOX_MODEL_MASK) {
+    case LAY_COLUMN | LAY_WRAP:
+        if (dim != 0) {
+            lay_soa_arrange_stacked(a, item, 1, true);
+            lay_scalar offset = lay_soa_arrange_wrapped_overlay_squeezed(a, item, 0);
+            a->rect[2 + 0][item] = offset - a->rect[0][item];
+        }
+        break;
+    case LAY_ROW | LAY_WRAP:
+        if (dim == 0)
+            lay_soa_arrange_stacked(a, item, 0, true);
+        else
+            lay_soa_arrange_wrapped_overlay_squeezed(a, item, 1);
+        break;
+    case LAY_COLUMN:
+    case LAY_ROW:
+        if ((flags & 1) == (uint32_t)dim) {
+            lay_soa_arrange_stacked(a, item, dim, false);
+        } else {
+            lay_soa_arrange_overlay_squeezed_range(a, dim, a->first[item],
+                a->first[item] + a->nchildren[item], a->rect[dim][item], a->rect[2 + dim][item]);
+        }
+        break;
+    default:
+        lay_soa_arrange_overlay(a, item, dim);
+        break;
+    }
+    const lay_id end = a->first[item] + a->nchildren[item];
+    for (lay_id child = a->first[item]; child < end; ++child)
+        lay_soa_arrange(a, child, dim);
+}
+
+static void lay_soa_run_item(lay_context *ctx, lay_id item)
+{
+    lay_soa_t *a = lay_soa_load(ctx, item);
+    lay_soa_calc_size(a, 0, 0);
+    lay_soa_arrange(a, 0, 0);
+    lay_soa_calc_size(a, 0, 1);
+    lay_soa_arrange(a, 0, 1);
+    lay_soa_store(ctx, a);
+}
+
+#endif // LAY_SOA
+
 #endif // LAY_IMPLEMENTATION
@@ -1,9 +1,36 @@
 #include "svggui.h"
+#include <algorithm>
 #include <chrono>
+#include <unordered_map>
 #include "usvg/svgparser.h"
 #include "usvg/svgpainter.h"
 #include "usvg/svgwriter.h"
 
+// file-static state here and below is shared by all SvgGui instances, so only one is supported - see svggui.h
+// layout.h allocations for pooled sub-layout contexts come from SvgGui::layoutArena; everything else goes to
+//  the heap (and is counted)
+static LayoutArena* frameArena = NULL;
+static bool allocFromArena = false;  // set while a pooled context may allocate a new block
+
+static void* layoutRealloc(void* p, size_t size)
+{
+  if(frameArena) {
+    if(p ? frameArena->owns(p) : allocFromArena)
+      return frameArena->realloc(p, size);
+    ++frameArena->stats.heapAllocs;
+  }
+  return realloc(p, size);
+}
+
+static void layoutFree(void* p)
+{
+  // arena blocks are released in bulk by LayoutArena::reset()
+  if(!frameArena || !frameArena->owns(p))
+    free(p);
+}
+
+#define LAY_REALLOC(_block, _size) layoutRealloc(_block, _size)
+#define LAY_FREE(_block) layoutFree(_block)
 #define LAY_IMPLEMENTATION
 #define LAY_FORCE_INLINE  // we don't need aggressive inlineing
 #include "layout.h"
@@ -12,27 +39,29 @@
 #error "Fix multiwindow for touch events, etc."
 #endif
 
-// seems we could use an unordered_set to do this more simply - add all ancestors of one node to set, walk
-//  up tree from other node until we find one in the set
+static int nodeDepth(const SvgNode* node)
+{
+  int depth = 0;
+  while((node = node->parent()))
+    ++depth;
+  return depth;
+}
+
+// nearest common ancestor w/o allocation: bring nodes to same depth, then walk up both until they meet
 static Widget* commonParent(const Widget* wa, const Widget* wb)
 {
-  SvgNode* a = wa->node;
-  SvgNode* b = wb->node;
-  std::vector<const SvgNode*> pathA;
-  std::vector<const SvgNode*> pathB;
-  while(a) {
-    pathA.push_back(a);
+  const SvgNode* a = wa->node;
+  const SvgNode* b = wb->node;
+  int da = nodeDepth(a), db = nodeDepth(b);
+  for(; da > db; --da)
+    a = a->parent();
+  for(; db > da; --db)
+    b = b->parent();
+  while(a != b) {
     a = a->parent();
-  }
-  while(b) {
-    pathB.push_back(b);
     b = b->parent();
   }
-  size_t ii = 1;
-  while(ii <= std::min(pathA.size(), pathB.size()) && pathA[pathA.size() - ii] == pathB[pathB.size() - ii])
-    ++ii;
-  const SvgNode* p = ii > 1 ? pathA[pathA.size() - ii + 1] : NULL;
-  return p ? static_cast<Widget*>(p->ext()) : NULL;
+  return a ? static_cast<Widget*>(a->ext()) : NULL;
 }
 
 static bool isDescendant(const Widget* child, const Widget* parent)
@@ -65,12 +94,46 @@ static Widget* getPressedGroupContainer(Widget* widget)
 Widget::Widget(SvgNode* n) : SvgNodeExtension(n), m_margins(Rect::ltrb(0,0,0,0)) {}
 
 //Widget::~Widget() { window()->gui()->widgetDeleted(this); }
+// widgets which may need layout, used instead of searching all dirty nodes if SvgGui::trackLayoutDirty is set
+static std::vector<Widget*> layoutDirtyWidgets;
+
+// scrolls to be drawn by shifting pixels in next frame (see SvgGui::scrollPixels)
+struct PendingScroll { Widget* viewport; Widget* contents; Point dr; };
+static std::vector<PendingScroll> pendingScrolls;
+
+Widget::~Widget()
+{
+  if(m_layoutDirtyRegistered)
+    layoutDirtyWidgets.erase(std::find(layoutDirtyWidgets.begin(), layoutDirtyWidgets.end(), this));
+  if(!pendingScrolls.empty()) {
+    pendingScrolls.erase(std::remove_if(pendingScrolls.begin(), pendingScrolls.end(), [this](const PendingScroll& ps){
+      return ps.viewport == this || ps.contents == this; }), pendingScrolls.end());
+  }
+}
+
+// widget and its descendants will be checked for layout changes in next frame
+void Widget::setLayoutDirty()
+{
+  if(SvgGui::trackLayoutDirty && !m_layoutDirtyRegistered) {
+    m_layoutDirtyRegistered = true;
+    layoutDirtyWidgets.push_back(this);
+  }
+}
 
 void Widget::removeFromParent()
 {
   SvgNode* p = node->parent();
-  if(p)
+  if(p) {
+    bumpLayoutGen();
+    ++EventFilter::generation;
+    for(SvgNode* n = p; n; n = n->parent()) {
+      if(n->hasExt()) {
+        static_cast<Widget*>(n->ext())->setLayoutDirty();
+        break;
+      }
+    }
     p->asContainerNode()->removeChild(node);
+  }
 }
 
 void Widget::setEnabled(bool enabled)
@@ -94,6 +157,7 @@ void Widget::setVisible(bool visible)
 {
   Window* win = window();
   bool displayed = isDisplayed();
+  bool wasvisible = isVisible();
   if(displayed != visible && win && win->gui())
     sdlUserEvent(win->gui(), visible ? SvgGui::VISIBLE : SvgGui::INVISIBLE);
 
@@ -107,7 +171,8 @@ void Widget::setVisible(bool visible)
         absPosNodes.erase(it);
         Rect r = node->m_renderedBounds;
         if(w->m_shadow) r.rectUnion(w->m_shadow->bounds(node->m_renderedBounds));
-        win->gui()->closedWindowBounds.rectUnion(r.translate(win->winBounds().origin()));
+        (w->compositeLayer ? win->gui()->closedLayerBounds : win->gui()->closedWindowBounds).rectUnion(
+            r.translate(win->winBounds().origin()));
       }
       else if(visible && it == absPosNodes.end())
         absPosNodes.push_back(w);
@@ -115,6 +180,10 @@ void Widget::setVisible(bool visible)
   }
   else
     node->setDisplayMode(visible ? SvgNode::BlockMode : SvgNode::NoneMode);
+  if(wasvisible != visible) {
+    bumpLayoutGen();
+    setLayoutDirty();
+  }
 
   // do this after setting NoneMode so we don't unnecessarily call onHideWidget for any children (e.g. menus)
   if(displayed && !visible && win && win->gui())
@@ -146,8 +215,11 @@ void Widget::setText(const char* s)
     textnode = static_cast<SvgText*>(node);
   else if(containerNode())
     textnode = static_cast<SvgText*>(containerNode()->selectFirst("text"));
-  if(textnode)
+  if(textnode) {
     textnode->setText(s);
+    bumpLayoutGen();
+    setLayoutDirty();
+  }
 }
 
 Widget* Widget::selectFirst(const char* selector) const
@@ -190,10 +262,66 @@ void Widget::addWidget(Widget* child)
   ASSERT(containerNode() && "cannot add widget to non-container node");
   ASSERT(!child->parent() && "Widget already has parent");
   containerNode()->addChild(child->node);
+  bumpLayoutGen();
+  ++EventFilter::generation;
+  setLayoutDirty();
   // should we allow chaining?
   //return *this;
 }
 
+static const struct { const char* name; unsigned int layoutGroups; } attrAtomInfo[ATOM_COUNT] = {
+  {"", 0}, {"left", Widget::LAYV_OFFSETS}, {"top", Widget::LAYV_OFFSETS}, {"right", Widget::LAYV_OFFSETS},
+  {"bottom", Widget::LAYV_OFFSETS}, {"box-anchor", Widget::LAYV_BEHAVE}, {"flex-break", Widget::LAYV_BEHAVE},
+  {"layout", Widget::LAYV_CONTAIN}, {"flex-direction", Widget::LAYV_CONTAIN}, {"flex-wrap", Widget::LAYV_CONTAIN},
+  {"justify-content", Widget::LAYV_CONTAIN}, {"box-shadow", Widget::LAYV_SHADOW},
+  {"border-radius", Widget::LAYV_RADIUS}, {"margin", Widget::LAYV_MARGINS}, {"margin-left", Widget::LAYV_MARGINS},
+  {"margin-top", Widget::LAYV_MARGINS}, {"margin-right", Widget::LAYV_MARGINS},
+  {"margin-bottom", Widget::LAYV_MARGINS}, {"position", 0}, {"render-cache", 0}
+};
+
+// open addressing hash table of atoms; most names are not atoms and just hit an empty slot
+static constexpr size_t ATOM_TABLE_SIZE = 64;
+
+static uint32_t atomHash(const char* name)
+{
+  uint32_t h = 2166136261u;  // FNV-1a
+  for(; *name; ++name)
+    h = (h ^ (unsigned char)*name) * 16777619u;
+  return h;
+}
+
+static const unsigned char* atomTable()
+{
+  static unsigned char table[ATOM_TABLE_SIZE] = {0};
+  static bool init = false;
+  if(!init) {
+    for(int atom = 1; atom < ATOM_COUNT; ++atom) {
+      size_t ii = atomHash(attrAtomInfo[atom].name) % ATOM_TABLE_SIZE;
+      while(table[ii])
+        ii = (ii + 1) % ATOM_TABLE_SIZE;
+      table[ii] = atom;
+    }
+    init = true;
+  }
+  return table;
+}
+
+int attrAtom(const char* name)
+{
+  static const unsigned char* table = atomTable();
+  size_t ii = atomHash(name) % ATOM_TABLE_SIZE;
+  for(; table[ii]; ii = (ii + 1) % ATOM_TABLE_SIZE) {
+    if(strcmp(attrAtomInfo[table[ii]].name, name) == 0)
+      return table[ii];
+  }
+  return ATOM_NONE;
+}
+
+unsigned int attrAtomLayoutGroups(int atom)
+{
+  return atom > ATOM_NONE && atom < ATOM_COUNT ? attrAtomInfo[atom].layoutGroups : 0;
+}
+
 // I think a better way to handle custom attributes that need to be subject to CSS is to store as
 //  SvgAttrs and provide either createExt or parseAttribute fn to SvgParser
 // ... but for legacy reasons, we will keep layout attrs as strings and cache parsed values in Widget
@@ -203,17 +331,93 @@ void Widget::addWidget(Widget* child)
 // Feel free to remove this after verifying no performance issues
 void Widget::onAttrChange(const char* name)
 {
-  static const char* layoutAttrs[] = {"left", "top", "right", "bottom", "box-anchor", "layout",
-      "flex-direction", "flex-wrap", "justify-content", "flex-break", "box-shadow", "border-radius"};
-  StringRef nameref(name);
-  if(layoutVarsValid && (nameref.startsWith("margin") || indexOfStr(nameref, layoutAttrs) >= 0)) {
+  int atom = attrAtom(name);
+  if(atom == ATOM_NONE)
+    return;
+  if(atom == ATOM_POSITION)
+    m_absPosNode = -1;
+  if(atom == ATOM_RENDER_CACHE) {
+    m_renderCacheMode = -1;
+    m_renderCache.reset();
+  }
+  unsigned int groups = attrAtomLayoutGroups(atom);
+  if(groups)
+    invalidateLayoutVars(groups);
+}
+
+// only the given groups of layout vars will be parsed again by updateLayoutVars()
+void Widget::invalidateLayoutVars(unsigned int groups)
+{
+  layoutVarsStale |= groups;
+  if(layoutVarsValid) {
     layoutVarsValid = false;
     node->setDirty(SvgNode::CHILD_DIRTY);
+    bumpLayoutGen();
+    setLayoutDirty();
   }
 }
 
-void Widget::updateLayoutVars()
+// note that we have no way to catch changes made directly to nodes, so cached layouts are only reused if node
+//  is not dirty (see SvgGui::layoutWidget)
+void Widget::bumpLayoutGen()
+{
+  for(SvgNode* n = node; n; n = n->parent()) {
+    Widget* w = static_cast<Widget*>(n->ext(false));
+    if(w)
+      ++w->layoutGen;
+  }
+}
+
+// parse box-anchor value, e.g. "left top", "hfill", "fill"
+static unsigned int parseBoxAnchor(StringRef anchor)
 {
+  static const char* words[] = {"fill", "hfill", "vfill", "left", "top", "right", "bottom"};
+  static const unsigned int wordFlags[] = {LAY_FILL, LAY_HFILL, LAY_VFILL, LAY_LEFT, LAY_TOP, LAY_RIGHT, LAY_BOTTOM};
+  unsigned int flags = 0;
+  while(!anchor.trimL().isEmpty()) {
+    int len = 0;
+    while(len < anchor.size() && anchor[len] != ' ')
+      ++len;
+    for(size_t ii = 0; ii < sizeof(words)/sizeof(words[0]); ++ii) {
+      if(int(strlen(words[ii])) == len && anchor.startsWith(words[ii]))
+        flags |= wordFlags[ii];
+    }
+    anchor.advance(len);
+  }
+  return flags;
+}
+
+static unsigned int parseLayoutContain(const SvgNode* node)
+{
+  StringRef layout = node->getStringAttr("layout", "");
+  if(layout.isEmpty())
+    return 0;
+  unsigned int flags = Widget::LAYX_HASLAYOUT;
+  flags |= layout == "box" ? LAY_LAYOUT : 0;
+  flags |= layout == "flex" ? LAY_FLEX : 0;
+
+  StringRef flexdir = node->getStringAttr("flex-direction", "");
+  flags |= flexdir == "row" ? LAY_ROW : 0;
+  flags |= flexdir == "column" ? LAY_COLUMN : 0;
+  // main motivation for supporting row/column-reverse is to allow item appearing to left or above another
+  //  to come after it in SVG so that it has higher z-index
+  flags |= flexdir == "row-reverse" ? (LAY_ROW | Widget::LAYX_REVERSE) : 0;
+  flags |= flexdir == "column-reverse" ? (LAY_COLUMN | Widget::LAYX_REVERSE) : 0;
+
+  if(StringRef(node->getStringAttr("flex-wrap", "")) == "wrap")
+    flags |= LAY_WRAP;
+
+  StringRef justify = node->getStringAttr("justify-content", "");
+  flags |= justify == "flex-start" ? LAY_START : 0;
+  flags |= justify == "flex-end" ? LAY_END : 0;
+  flags |= justify == "center" ? LAY_CENTER : 0;
+  flags |= justify == "space-between" ? LAY_JUSTIFY : 0;
+  return flags;
+}
+
+static Rect parseMargins(const SvgNode* node)
+{
+  Rect margins = Rect::ltrb(0, 0, 0, 0);
   StringRef marginstr = node->getStringAttr("margin");
   if(!marginstr.isEmpty()) {
     std::vector<real> margin;
@@ -226,116 +430,126 @@ void Widget::updateLayoutVars()
       margin = {margin[0], margin[1], margin[0], margin[1]};
     else if(margin.size() == 3)  // t r&l b
       margin = {margin[0], margin[1], margin[2], margin[1]};
-    m_margins = Rect::ltrb(margin[3], margin[0], margin[1], margin[2]);
+    margins = Rect::ltrb(margin[3], margin[0], margin[1], margin[2]);
   }
-  else
-    m_margins = Rect::ltrb(0, 0, 0, 0);
 
   // we should remove margin-left, etc., since margin attribute does not cascade and default value is 0,
   //  unlike (offset)"left", etc. where 0 is not the same as the attribute not being set
-  m_margins.left = toReal(node->getStringAttr("margin-left"), m_margins.left);
-  m_margins.top = toReal(node->getStringAttr("margin-top"), m_margins.top);
-  m_margins.right = toReal(node->getStringAttr("margin-right"), m_margins.right);
-  m_margins.bottom = toReal(node->getStringAttr("margin-bottom"), m_margins.bottom);
-
-  //parseLength(node->getStringAttr("max-width"), NaN);
-  //parseLength(node->getStringAttr("max-height"), NaN);
+  margins.left = toReal(node->getStringAttr("margin-left"), margins.left);
+  margins.top = toReal(node->getStringAttr("margin-top"), margins.top);
+  margins.right = toReal(node->getStringAttr("margin-right"), margins.right);
+  margins.bottom = toReal(node->getStringAttr("margin-bottom"), margins.bottom);
+  return margins;
+}
 
-  layContain = 0;
-  StringRef layout = node->getStringAttr("layout", "");
-  if(!layout.isEmpty()) {
-    layContain = LAYX_HASLAYOUT;
-    layContain |= layout == "box" ? LAY_LAYOUT : 0;
-    layContain |= layout == "flex" ? LAY_FLEX : 0;
-
-    StringRef flexdir = node->getStringAttr("flex-direction", "");
-    layContain |= flexdir == "row" ? LAY_ROW : 0;
-    layContain |= flexdir == "column" ? LAY_COLUMN : 0;
-    // main motivation for supporting row/column-reverse is to allow item appearing to left or above another
-    //  to come after it in SVG so that it has higher z-index
-    layContain |= flexdir == "row-reverse" ? (LAY_ROW | LAYX_REVERSE) : 0;
-    layContain |= flexdir == "column-reverse" ? (LAY_COLUMN | LAYX_REVERSE) : 0;
-
-    if(StringRef(node->getStringAttr("flex-wrap", "")) == "wrap")
-      layContain |= LAY_WRAP;
-
-    StringRef justify = node->getStringAttr("justify-content", "");
-    layContain |= justify == "flex-start" ? LAY_START : 0;
-    layContain |= justify == "flex-end" ? LAY_END : 0;
-    layContain |= justify == "center" ? LAY_CENTER : 0;
-    layContain |= justify == "space-between" ? LAY_JUSTIFY : 0;
-  }
-
-  layBehave = 0;
-  StringRef anchor = node->getStringAttr("box-anchor", "");
-  if(!anchor.isEmpty()) {
-    if(anchor == "fill")
-      layBehave |= LAY_FILL;
-    else {
-      if(anchor.contains("left") || anchor.contains("hfill"))
-        layBehave |= LAY_LEFT;
-      if(anchor.contains("top") || anchor.contains("vfill"))
-        layBehave |= LAY_TOP;
-      if(anchor.contains("right") || anchor.contains("hfill"))
-        layBehave |= LAY_RIGHT;
-      if(anchor.contains("bottom") || anchor.contains("vfill"))
-        layBehave |= LAY_BOTTOM;
-    }
-  }
-  if(StringRef(node->getStringAttr("flex-break", "")) == "before")
-    layBehave |= LAY_BREAK;
-
-  m_shadow.reset();
-  const char* shadow = node->getStringAttr("box-shadow");
-  if(shadow) {
-    m_shadow = std::make_unique<BoxShadow>();
-    StringRef shd(shadow);
-    m_shadow->dx = parseLength(shd, SvgLength(0)).value;
+static std::unique_ptr<Widget::BoxShadow> parseBoxShadow(const char* shadow)
+{
+  if(!shadow)
+    return NULL;
+  auto res = std::make_unique<Widget::BoxShadow>();
+  StringRef shd(shadow);
+  res->dx = parseLength(shd, SvgLength(0)).value;
+  shd.advance(shd.find(" ")).trimL();
+  res->dy = parseLength(shd, SvgLength(0)).value;
+  shd.advance(shd.find(" ")).trimL();
+  if(!shd.isEmpty() && isDigit(shd[0])) {
+    res->blur = parseLength(shd, SvgLength(0)).value;  // nanovg "feather"
     shd.advance(shd.find(" ")).trimL();
-    m_shadow->dy = parseLength(shd, SvgLength(0)).value;
+  }
+  if(!shd.isEmpty() && (isDigit(shd[0]) || shd[0] == '-')) {  // spread can be negative
+    res->spread = parseLength(shd, SvgLength(0)).value;  // padding for rect
     shd.advance(shd.find(" ")).trimL();
-    if(!shd.isEmpty() && isDigit(shd[0])) {
-      m_shadow->blur = parseLength(shd, SvgLength(0)).value;  // nanovg "feather"
-      shd.advance(shd.find(" ")).trimL();
-    }
-    if(!shd.isEmpty() && (isDigit(shd[0]) || shd[0] == '-')) {  // spread can be negative
-      m_shadow->spread = parseLength(shd, SvgLength(0)).value;  // padding for rect
-      shd.advance(shd.find(" ")).trimL();
-    }
-    if(shd.startsWith("inset"))
-      shd.advance(5).trimL();
-    m_shadow->color = parseColor(shd, Color::BLACK);
-    //if(std::isnan(dx) || std::isnan(dy) || std::isnan(blur) || std::isnan(spread))
   }
+  if(shd.startsWith("inset"))
+    shd.advance(5).trimL();
+  res->color = parseColor(shd, Color::BLACK);
+  //if(std::isnan(dx) || std::isnan(dy) || std::isnan(blur) || std::isnan(spread))
+  return res;
+}
 
-  StringRef radiusstr = node->getStringAttr("border-radius");
-  std::vector<real> radii;
-  parseNumbersList(radiusstr, radii);
-  if(node->type() == SvgNode::RECT) {
-    SvgRect* rnode = static_cast<SvgRect*>(node);
-    if(radii.size() == 1)  // all equal
-      rnode->setCornerRadii(radii[0], radii[0], radii[0], radii[0]);
-    else if(radii.size() == 4)  // top-left | top-right | bottom-right | bottom-left
-      rnode->setCornerRadii(radii[0], radii[1], radii[2], radii[3]);
-    else
-      rnode->setCornerRadii(0, 0, 0, 0);
+// cached since this is checked for dirty nodes every frame; reset by onAttrChange()
+bool Widget::isAbsPosNode() const
+{
+  if(m_absPosNode < 0)
+    m_absPosNode = StringRef(node->getStringAttr("position")) == "absolute" ? 1 : 0;
+  return m_absPosNode > 0;
+}
+
+// only groups of attributes flagged in layoutVarsStale (by onAttrChange) are parsed, so that restyling
+//  which changes one layout attribute doesn't require parsing all of them
+void Widget::updateLayoutVars()
+{
+  unsigned int stale = layoutVarsStale;
+  if(stale & LAYV_MARGINS)
+    m_margins = parseMargins(node);
+
+  //parseLength(node->getStringAttr("max-width"), NaN);
+  //parseLength(node->getStringAttr("max-height"), NaN);
+
+  if(stale & LAYV_CONTAIN)
+    layContain = parseLayoutContain(node);
+
+  if(stale & LAYV_BEHAVE) {
+    layBehave = parseBoxAnchor(node->getStringAttr("box-anchor", ""));
+    if(StringRef(node->getStringAttr("flex-break", "")) == "before")
+      layBehave |= LAY_BREAK;
+  }
+
+  if(stale & LAYV_SHADOW)
+    m_shadow = parseBoxShadow(node->getStringAttr("box-shadow"));
+
+  // shadow radius comes from border-radius
+  if(stale & (LAYV_RADIUS | LAYV_SHADOW)) {
+    StringRef radiusstr = node->getStringAttr("border-radius");
+    std::vector<real> radii;
+    parseNumbersList(radiusstr, radii);
+    if((stale & LAYV_RADIUS) && node->type() == SvgNode::RECT) {
+      SvgRect* rnode = static_cast<SvgRect*>(node);
+      if(radii.size() == 1)  // all equal
+        rnode->setCornerRadii(radii[0], radii[0], radii[0], radii[0]);
+      else if(radii.size() == 4)  // top-left | top-right | bottom-right | bottom-left
+        rnode->setCornerRadii(radii[0], radii[1], radii[2], radii[3]);
+      else
+        rnode->setCornerRadii(0, 0, 0, 0);
+    }
+    if(m_shadow)
+      m_shadow->radius = radii.empty() ? 0 : radii[0];
   }
-  if(m_shadow)
-    m_shadow->radius = radii.empty() ? 0 : radii[0];
 
+  layoutVarsStale = 0;
   layoutVarsValid = true;
 }
 
 void AbsPosWidget::updateLayoutVars()
 {
-  offsetLeft = parseLength(node->getStringAttr("left"), NaN);
-  offsetTop = parseLength(node->getStringAttr("top"), NaN);
-  offsetRight = parseLength(node->getStringAttr("right"), NaN);
-  offsetBottom = parseLength(node->getStringAttr("bottom"), NaN);
+  if(layoutVarsStale & LAYV_OFFSETS) {
+    offsetLeft = parseLength(node->getStringAttr("left"), NaN);
+    offsetTop = parseLength(node->getStringAttr("top"), NaN);
+    offsetRight = parseLength(node->getStringAttr("right"), NaN);
+    offsetBottom = parseLength(node->getStringAttr("bottom"), NaN);
+  }
 
   Widget::updateLayoutVars();
 }
 
+// set offsets directly instead of with left, top, etc. attributes (which will override if set later);
+//  offsets not passed are cleared
+void AbsPosWidget::setOffsets(const SvgLength& left, const SvgLength& top, const SvgLength& right, const SvgLength& bottom)
+{
+  auto sameLength = [](const SvgLength& a, const SvgLength& b) {
+    return a.isValid() ? (b.isValid() && a.value == b.value && a.units == b.units) : !b.isValid();
+  };
+  if(!(layoutVarsStale & LAYV_OFFSETS) && sameLength(left, offsetLeft) && sameLength(top, offsetTop)
+      && sameLength(right, offsetRight) && sameLength(bottom, offsetBottom))
+    return;
+  offsetLeft = left;
+  offsetTop = top;
+  offsetRight = right;
+  offsetBottom = bottom;
+  invalidateLayoutVars(0);
+  layoutVarsStale &= ~LAYV_OFFSETS;
+}
+
 const Rect& Widget::margins() const
 {
   // this is only used by prepareLayout; we want to preserve layoutVarsValid for needsLayout()
@@ -363,15 +577,42 @@ void Widget::serializeAttr(SvgWriter* writer)
   }
 }
 
+// translate cached bounds of node and descendants, e.g. after change to translation of layout transform
+// if node has valid cached bounds, all children should as well, so caller just needs to check top-level node
+void translateCachedBounds(SvgNode* node, const Point& dr)
+{
+  node->m_cachedBounds.translate(dr);
+  auto* cnode = node->asContainerNode();
+  if(cnode) {
+    for(SvgNode* child : cnode->children())
+      translateCachedBounds(child, dr);
+  }
+}
+
+// shift rendered bounds of node and descendants after rendered pixels are shifted
+static void translateRenderedBounds(SvgNode* node, const Point& dr)
+{
+  if(node->m_renderedBounds.isValid())
+    node->m_renderedBounds.translate(dr);
+  auto* cnode = node->asContainerNode();
+  if(cnode) {
+    for(SvgNode* child : cnode->children())
+      translateRenderedBounds(child, dr);
+  }
+}
+
+// if only translation changes, we just shift cached bounds instead of invalidating, which would require
+//  bounds of entire subtree to be recalculated (w/ BOUNDS_DIRTY, node's old rendered bounds are still
+//  included in dirty rect); layout translation is applied in the parent's (unscaled) coordinates, so the
+//  change in offset is exactly the change in bounds
 void Widget::setLayoutTransform(const Transform2D& tf)
 {
   if(tf != m_layoutTransform) {
-    //const real* m0 = m_layoutTransform.asArray();
-    //const real* m1 = tf.asArray();
-#if 0 //def NDEBUG
-    if(m1[0] == m0[0] && m1[1] == m0[1] && m1[2] == m0[2] && m1[3] == m0[3]) {
-      if(node->cachedBounds().isValid())
-        translateCachedBounds(node, Point(m1[4] - m0[4], m1[5] - m0[5]));
+    const Transform2D& tf0 = m_layoutTransform;
+    bool translateonly = tf.m[0] == tf0.m[0] && tf.m[1] == tf0.m[1] && tf.m[2] == tf0.m[2] && tf.m[3] == tf0.m[3];
+#ifndef DEBUG_CACHED_BOUNDS
+    if(translateonly && node->cachedBounds().isValid()) {
+      translateCachedBounds(node, Point(tf.m[4] - tf0.m[4], tf.m[5] - tf0.m[5]));
       node->setDirty(SvgNode::BOUNDS_DIRTY);
     }
     else
@@ -382,6 +623,67 @@ void Widget::setLayoutTransform(const Transform2D& tf)
   }
 }
 
+// incremented by layoutAndDraw so render cache is only updated once per frame
+static unsigned int drawFrameCount = 0;
+static const Widget* renderingCacheFor = NULL;
+// offscreen images drawn in current frame - see DeferredFrame
+static std::vector< std::shared_ptr<Image> > frameImages;
+
+// shadow is drawn as a nine-patch from a bitmap cached for each (radius, blur, color, scale), shared by all
+//  widgets with same shadow regardless of size; with box gradient, pixels more than radius + blur inside box
+//  edge only vary perpendicular to the edge, so these can be stretched
+struct ShadowCacheEntry
+{
+  Color color;
+  real radius, blur, scale;
+  int cornerpx;
+  std::shared_ptr<Image> image;
+  unsigned int frame;
+};
+static std::vector<ShadowCacheEntry> shadowCache;
+static constexpr size_t maxShadowCache = 32;
+static constexpr int shadowStretchPx = 4;
+
+// cached bitmap is rasterized w/ software painter, so w/o it we always draw shadow w/ box gradient
+#ifdef NO_PAINTER_SW
+static ShadowCacheEntry* getShadowCache(const Widget::BoxShadow*, real) { return NULL; }
+#else
+static ShadowCacheEntry* getShadowCache(const Widget::BoxShadow* shd, real scale)
+{
+  for(ShadowCacheEntry& e : shadowCache) {
+    if(e.radius == shd->radius && e.blur == shd->blur && e.scale == scale && e.color == shd->color) {
+      e.frame = drawFrameCount;
+      return &e;
+    }
+  }
+  if(shadowCache.size() >= maxShadowCache) {
+    auto lru = std::min_element(shadowCache.begin(), shadowCache.end(),
+        [](const ShadowCacheEntry& a, const ShadowCacheEntry& b){ return a.frame < b.frame; });
+    shadowCache.erase(lru);
+  }
+  real pad = 0.5*shd->blur + 1;
+  int cpx = int(std::ceil((pad + shd->radius + shd->blur)*scale));
+  int dim = 2*cpx + shadowStretchPx;
+  auto image = std::make_shared<Image>(dim, dim);
+  memset(image->bytes(), 0, size_t(dim)*dim*4);
+  Painter cp(Painter::PAINT_SW, image.get());
+  cp.deviceRect = Rect::wh(dim, dim);
+  cp.beginFrame();
+  cp.setsRGBAdjAlpha(true);
+  cp.scale(scale);
+  real size = dim/scale;
+  Gradient grad = Gradient::box(pad, pad, size - 2*pad, size - 2*pad, shd->radius, shd->blur);
+  grad.coordMode = Gradient::userSpaceOnUseMode;
+  grad.addStop(0, shd->color);
+  grad.addStop(1, Color(shd->color).setAlphaF(0));
+  cp.setFillBrush(&grad);
+  cp.drawRect(Rect::wh(size, size));
+  cp.endFrame();
+  shadowCache.push_back({shd->color, shd->radius, shd->blur, scale, cpx, image, drawFrameCount});
+  return &shadowCache.back();
+}
+#endif
+
 static void drawShadow(SvgPainter* svgp, const Widget* w)
 {
   Rect bounds = w->node->bounds();
@@ -394,52 +696,279 @@ static void drawShadow(SvgPainter* svgp, const Widget* w)
   p->save();
   p->setTransform(svgp->initialTransform);
   p->translate(bounds.origin());  // - w->m_layoutTransform.map(Point(0,0)));
-  Gradient grad = Gradient::box(shd->dx, shd->dy, bounds.width(), bounds.height(), shd->radius, shd->blur);
-  grad.coordMode = Gradient::userSpaceOnUseMode;
-  //grad.setObjectBBox(Rect::ltwh(d, props.height, props.width, d));
-  grad.addStop(0, shd->color);
-  grad.addStop(1, Color(shd->color).setAlphaF(0));
-  p->setFillBrush(&grad);
-  p->drawRect(shdbnds);
+  real scale = svgp->initialTransform.xscale();
+  ShadowCacheEntry* cache = scale > 0 ? getShadowCache(shd, scale) : NULL;
+  real c = cache ? cache->cornerpx/scale : 0;
+  if(cache && shdbnds.width() >= 2*c && shdbnds.height() >= 2*c) {
+    int cpx = cache->cornerpx, mpx = shadowStretchPx;
+    real dstx[] = {shdbnds.left, shdbnds.left + c, shdbnds.right - c, shdbnds.right};
+    real dsty[] = {shdbnds.top, shdbnds.top + c, shdbnds.bottom - c, shdbnds.bottom};
+    real srcpx[] = {0, real(cpx), real(cpx + mpx), real(2*cpx + mpx)};
+    for(int iy = 0; iy < 3; ++iy) {
+      for(int ix = 0; ix < 3; ++ix) {
+        if(dstx[ix+1] > dstx[ix] && dsty[iy+1] > dsty[iy]) {
+          p->drawImage(*cache->image, Rect::ltrb(dstx[ix], dsty[iy], dstx[ix+1], dsty[iy+1]),
+              Rect::ltrb(srcpx[ix], srcpx[iy], srcpx[ix+1], srcpx[iy+1]));
+        }
+      }
+    }
+    if(frameImages.empty() || frameImages.back() != cache->image)
+      frameImages.push_back(cache->image);
+  }
+  else {
+    Gradient grad = Gradient::box(shd->dx, shd->dy, bounds.width(), bounds.height(), shd->radius, shd->blur);
+    grad.coordMode = Gradient::userSpaceOnUseMode;
+    //grad.setObjectBBox(Rect::ltwh(d, props.height, props.width, d));
+    grad.addStop(0, shd->color);
+    grad.addStop(1, Color(shd->color).setAlphaF(0));
+    p->setFillBrush(&grad);
+    p->drawRect(shdbnds);
+  }
+  p->restore();
+}
+
+void Widget::setRenderCache(bool cache)
+{
+  m_renderCacheMode = cache ? 1 : 0;
+  if(!cache)
+    m_renderCache.reset();
+  redraw();
+}
+
+// cached image is rendered w/ software painter, so w/o it widgets are always drawn normally
+bool Widget::usesRenderCache() const
+{
+#ifdef NO_PAINTER_SW
+  return false;
+#else
+  if(m_renderCacheMode < 0)
+    m_renderCacheMode = StringRef(node->getStringAttr("render-cache", "")) == "bitmap" ? 1 : 0;
+  return m_renderCacheMode > 0;
+#endif
+}
+
+// occlusion culling: when drawing a window, nodes drawn before an opaque node (other than its ancestors) which
+//  covers the entire clip rect are skipped by setting an empty clip rect in applyStyle (as for render cache)
+static std::vector<const SvgNode*> occludedNodes;  // sorted
+
+// returns rect (in window coords) fully covered by node's fill (w/o any clipping by ancestors), or invalid rect
+//  if node is not an opaque rect; fill must be set directly on node.  CSS restyle is lazy (done when node is
+//  drawn), so attributes of a dirty node or a node w/ a dirty ancestor (e.g. class change pending restyle) may
+//  not be what will be drawn - these are never treated as opaque
+static Rect opaqueRect(const SvgNode* node)
+{
+  if(node->type() != SvgNode::RECT || !node->isPaintable() || node->m_dirty != SvgNode::NOT_DIRTY)
+    return Rect();
+  const char* fill = node->getStringAttr("fill");
+  if(!fill || node->getFloatAttr("fill-opacity", 1) < 1)
+    return Rect();
+  Color color = parseColor(fill);
+  if(!color.isValid() || color.alpha() < 255)
+    return Rect();
+  const char* stroke = node->getStringAttr("stroke");
+  if((stroke && strcmp(stroke, "none") != 0) || node->getFloatAttr("rx", 0) > 0 || node->getFloatAttr("ry", 0) > 0)
+    return Rect();
+  Transform2D tf = node->totalTransform();
+  if(tf.m[1] != 0 || tf.m[2] != 0)
+    return Rect();
+  Rect r = node->bounds();
+  r.pad(-1);  // antialiased edges
+  for(const SvgNode* n = node; n; n = n->parent()) {
+    if(n->m_dirty > SvgNode::CHILD_DIRTY || n->opacity() < 1 || n->hasAttribute("clip-path") || n->hasAttribute("mask") || n->hasAttribute("filter"))
+      return Rect();
+    if(n != node && n->type() == SvgNode::DOC)
+      r.rectIntersect(n->bounds());
+  }
+  return r;
+}
+
+// find last node in paint order in subtree of node which covers clip rect r; only need to descend into nodes
+//  with bounds containing r
+static const SvgNode* findOccluder(const SvgNode* node, const Rect& r)
+{
+  const SvgContainerNode* container = node->asContainerNode();
+  if(container) {
+    for(auto it = container->children().rbegin(); it != container->children().rend(); ++it) {
+      const SvgNode* child = *it;
+      // abs pos nodes are drawn separately
+      if(!child->isVisible() || child->displayMode() == SvgNode::AbsoluteMode || !child->bounds().contains(r))
+        continue;
+      const SvgNode* occluder = findOccluder(child, r);
+      if(occluder)
+        return occluder;
+    }
+  }
+  Rect opaque = opaqueRect(node);
+  return opaque.isValid() && opaque.contains(r) ? node : NULL;
+}
+
+static void findOccludedNodes(const SvgNode* root, const Rect& clip)
+{
+  occludedNodes.clear();
+  const SvgNode* occluder = findOccluder(root, clip);
+  for(const SvgNode* n = occluder; n && n != root; n = n->parent()) {
+    for(const SvgNode* sibling : n->parent()->children()) {
+      if(sibling == n)
+        break;
+      occludedNodes.push_back(sibling);
+    }
+  }
+  std::sort(occludedNodes.begin(), occludedNodes.end());
+}
+
+#ifndef NO_PAINTER_SW
+// Render cache: usvg has no way to skip drawing a subtree from applyStyle, so after drawing the cached image,
+//  we set an empty clip rect so that contents are not rasterized (they are still traversed by SvgPainter)
+static void drawRenderCache(SvgPainter* svgp, const Widget* w)
+{
+  Painter* p = svgp->p;
+  Rect b = w->node->bounds();
+  Rect devbounds = svgp->initialTransform.mapRect(b);
+  devbounds = Rect::ltrb(std::floor(devbounds.left), std::floor(devbounds.top),
+      std::ceil(devbounds.right), std::ceil(devbounds.bottom));
+  if(devbounds.width() < 1 || devbounds.height() < 1)
+    return;
+  Widget::RenderCache* cache = w->m_renderCache.get();
+  bool stale = !cache || (w->node->m_dirty != SvgNode::NOT_DIRTY && cache->frame != drawFrameCount)
+      || devbounds.toSize() != cache->devBounds.toSize();
+  if(stale) {
+    if(!cache)
+      w->m_renderCache.reset(cache = new Widget::RenderCache);
+    int imgw = int(devbounds.width()), imgh = int(devbounds.height());
+    if(!cache->image || cache->image->width != imgw || cache->image->height != imgh)
+      cache->image.reset(new Image(imgw, imgh));
+    memset(cache->image->bytes(), 0, size_t(imgw)*imgh*4);
+    // draw the same way layoutAndDraw draws abs pos nodes, but w/ origin at devbounds
+    Painter cp(Painter::PAINT_SW, cache->image.get());
+    cp.deviceRect = Rect::wh(devbounds.width(), devbounds.height());
+    cp.beginFrame();
+    cp.setsRGBAdjAlpha(true);
+    cp.setTransform(Transform2D::translating(-devbounds.left, -devbounds.top) * svgp->initialTransform);
+    const Widget* prevfor = renderingCacheFor;
+    renderingCacheFor = w;
+    SvgPainter(&cp).drawNode(w->node, b);
+    renderingCacheFor = prevfor;
+    cp.endFrame();
+    cache->frame = drawFrameCount;
+    if(cache->image->painterHandle >= 0)
+      p->invalidateImage(cache->image->painterHandle);
+  }
+  cache->devBounds = devbounds;
+  if(frameImages.empty() || frameImages.back() != cache->image)
+    frameImages.push_back(cache->image);
+
+  p->save();
+  p->setTransform(Transform2D());
+  p->drawImage(*cache->image, devbounds);
   p->restore();
+  p->setClipRect(Rect::ltwh(0, 0, 0, 0));
 }
+#endif
 
 void Widget::applyStyle(SvgPainter* svgp) const
 {
+  if(!occludedNodes.empty() && svgp->dirtyRect.isValid() && !renderingCacheFor
+      && std::binary_search(occludedNodes.begin(), occludedNodes.end(), node)) {
+    svgp->p->setClipRect(Rect::ltwh(0, 0, 0, 0));  // completely hidden
+    return;
+  }
+
   // `svgp->p->transform(m_layoutTransform)` works w/ the corresponding code using totalTransform() in
   //  setLayoutBounds(), except for a few glitches (e.g. w/ first layout of menus)
   // I think our original (and current) approach of applying layout translation before SVG transform and
   //  layout scaling after is probably better ... we should probably implement paintScale separately from
   //  Painter transform (just divide by scale in Painter::getTransform())
 
-  if(m_layoutTransform.isIdentity())
-    return;
+  if(!m_layoutTransform.isIdentity()) {
+    Transform2D tf = svgp->p->getTransform();
+    // We should think of layout transform not as a proper transform, but as a way of keeping track of the
+    //  translation and scaling to be applied in a special way to the node
+    // We apply layout transform directly and assume both it and initialTransform have only scale and translation
+    tf.m[0] *= m_layoutTransform.xscale();
+    tf.m[3] *= m_layoutTransform.yscale();
+    tf.m[4] += m_layoutTransform.xoffset() * svgp->initialTransform.xscale();
+    tf.m[5] += m_layoutTransform.yoffset() * svgp->initialTransform.yscale();
+    svgp->p->setTransform(tf);
+
+    // valid dirty rect indicates rendering (as opposed to bounds calculation); shadow of widget w/ render
+    //  cache is drawn when drawing cached image, not into it
+    if(svgp->dirtyRect.isValid() && m_shadow && renderingCacheFor != this)
+      drawShadow(svgp, this);
+  }
+
+#ifndef NO_PAINTER_SW
+  if(svgp->dirtyRect.isValid() && renderingCacheFor != this && usesRenderCache())
+    drawRenderCache(svgp, this);
+#endif
+}
 
-  Transform2D tf = svgp->p->getTransform();
-  // We should think of layout transform not as a proper transform, but as a way of keeping track of the
-  //  translation and scaling to be applied in a special way to the node
-  // We apply layout transform directly and assume both it and initialTransform have only scale and translation
-  tf.m[0] *= m_layoutTransform.xscale();
-  tf.m[3] *= m_layoutTransform.yscale();
-  tf.m[4] += m_layoutTransform.xoffset() * svgp->initialTransform.xscale();
-  tf.m[5] += m_layoutTransform.yoffset() * svgp->initialTransform.yscale();
-  svgp->p->setTransform(tf);
+unsigned int Widget::eventMask(Uint32 type)
+{
+  switch(type) {
+  case SDL_FINGERMOTION:
+  case SDL_MOUSEMOTION:
+    return MOTION_EVENTS;
+  case SDL_FINGERDOWN:
+  case SDL_FINGERUP:
+  case SVGGUI_FINGERCANCEL:
+  case SDL_MOUSEBUTTONDOWN:
+  case SDL_MOUSEBUTTONUP:
+  case SvgGui::LONG_PRESS:
+  case SvgGui::OUTSIDE_PRESSED:
+  case SvgGui::OUTSIDE_MODAL:
+    return PRESS_EVENTS;
+  case SvgGui::MULTITOUCH:
+    return MULTITOUCH_EVENTS;
+  case SvgGui::ENTER:
+  case SvgGui::LEAVE:
+    return HOVER_EVENTS;
+  case SvgGui::FOCUS_GAINED:
+  case SvgGui::FOCUS_LOST:
+    return FOCUS_EVENTS;
+  case SDL_KEYDOWN:
+  case SDL_KEYUP:
+  case SDL_TEXTINPUT:
+  case SvgGui::KEYBOARD_HIDDEN:
+  case SvgGui::IME_TEXT_UPDATE:
+    return KEY_EVENTS;
+  case SDL_MOUSEWHEEL:
+    return WHEEL_EVENTS;
+  case SvgGui::ENABLED:
+  case SvgGui::DISABLED:
+  case SvgGui::VISIBLE:
+  case SvgGui::INVISIBLE:
+    return STATE_EVENTS;
+  default:
+    return OTHER_EVENTS;
+  }
+}
 
-  // valid dirty rect indicates rendering (as opposed to bounds calculation)
-  if(svgp->dirtyRect.isValid() && m_shadow)
-    drawShadow(svgp, this);
+void Widget::addHandler(const std::function<bool(SvgGui*, SDL_Event*)>& fn, unsigned int mask)
+{
+  sdlHandlers.emplace_back(fn);
+  // in case handlers were added to sdlHandlers directly - these must receive all events
+  if(sdlHandlerMasks.size() + 1 < sdlHandlers.size())
+    sdlHandlersMask = ALL_EVENTS;
+  sdlHandlerMasks.resize(sdlHandlers.size(), ALL_EVENTS);
+  sdlHandlerMasks.back() = mask;
+  sdlHandlersMask |= mask;
 }
 
-// note we use rbegin/rend, so handlers added later have priority!  Add flag to addHandler to control this?
+// note we iterate backwards, so handlers added later have priority!  Add flag to addHandler to control this?
 bool Widget::sdlEvent(SvgGui* gui, SDL_Event* event)
 {
-  if(sdlHandlers.empty() || !isEnabled())
+  if(sdlHandlers.empty())
+    return false;
+  // if sizes differ, handlers were added directly to sdlHandlers, so send to all
+  bool masked = sdlHandlerMasks.size() == sdlHandlers.size();
+  unsigned int mask = eventMask(event->type);
+  if((masked && !(sdlHandlersMask & mask)) || !isEnabled())
     return false;
   gui->eventWidget = this;
   gui->currSDLEvent = event;
 
-  for(auto it = sdlHandlers.rbegin(); it != sdlHandlers.rend(); ++it)  {
-    if((*it)(gui, event))
+  for(size_t ii = sdlHandlers.size(); ii-- > 0;) {
+    if((!masked || (sdlHandlerMasks[ii] & mask)) && sdlHandlers[ii](gui, event))
       return true;
   }
   return false;
@@ -460,7 +989,7 @@ bool Widget::sdlUserEvent(SvgGui* gui, Uint32 type, Sint32 code, void* data1, vo
 void Window::setWinBounds(const Rect& r)
 {
   if(r != mBounds && mBounds.width() > 0 && mBounds.height() > 0 && svgGui && !sdlWindow)
-    svgGui->closedWindowBounds.rectUnion(mBounds);  // handle change in window size
+    (compositeLayer ? svgGui->closedLayerBounds : svgGui->closedWindowBounds).rectUnion(mBounds);  // handle change in window size
 
   if(node->type() == SvgNode::DOC && r.toSize() != mBounds.toSize()) {
     // width or height in % units w/o valid canvasRect will cause doc bounds() to return content bounds
@@ -497,9 +1026,12 @@ void Window::setWindowXmlClass(const char* xmlcls)
 
 bool SvgGui::debugLayout = false;
 bool SvgGui::debugDirty = false;
+bool SvgGui::debugLayoutAllocs = false;
+bool SvgGui::trackLayoutDirty = false;
 
 SvgGui::SvgGui()
 {
+  frameArena = &layoutArena;
   lay_context* ctx = &layoutCtx;
   lay_init_context(ctx);
   lay_reserve_items_capacity(ctx, 1024);
@@ -510,6 +1042,9 @@ SvgGui::~SvgGui()
 {
   ASSERT(windows.empty() && "All windows must be closed before deleting SvgGui object.");
   lay_destroy_context(&layoutCtx);
+  releaseLayoutPool();
+  if(frameArena == &layoutArena)
+    frameArena = NULL;
 
   if(timerThread) {
     nextTimeout = 0;
@@ -612,11 +1147,183 @@ void SvgGui::removeTimers(Widget* w, bool children)
     timers.remove_if([w](const Timer& timer) { return timer.widget == w; });
 }
 
+// persistent layout: item flag bits (from LAY_USERMASK) needed to restore LAY_BREAK when reusing items
+enum { LAYI_FLEXBREAK = 0x00010000, LAYI_HASWRAP = 0x00020000 };
+
+bool LayoutTree::contains(const Widget* w) const
+{
+  int id = w->layoutId();
+  return id >= 0 && id < int(widgets.size()) && widgets[id] == w;
+}
+
+void LayoutTree::clear()
+{
+  lay_reset_context(&ctx);
+  widgets.clear();
+  prevRects.clear();
+  reused.clear();
+  rebuildCount = 0;
+}
+
+LayoutArena::~LayoutArena()
+{
+  ::free(buf);
+}
+
+void* LayoutArena::realloc(void* p, size_t size)
+{
+  size_t oldsize = p ? *(size_t*)((char*)p - ALIGN) : 0;
+  size_t blocksize = ALIGN + ((size + ALIGN - 1) & ~(ALIGN - 1));
+  // last block can be resized in place
+  if(p && (char*)p == buf + lastBlock + ALIGN && lastBlock + blocksize <= capacity) {
+    used = lastBlock + blocksize;
+    *(size_t*)(buf + lastBlock) = size;
+    ++stats.arenaAllocs;
+    return p;
+  }
+  char* q;
+  if(used + blocksize <= capacity) {
+    lastBlock = used;
+    used += blocksize;
+    *(size_t*)(buf + lastBlock) = size;
+    q = buf + lastBlock + ALIGN;
+    ++stats.arenaAllocs;
+  }
+  else {
+    // out of space - use heap for rest of frame and grow buffer in reset()
+    overflow += blocksize;
+    q = (char*)::malloc(size);
+    ++stats.heapAllocs;
+  }
+  if(p)
+    memcpy(q, p, std::min(oldsize, size));
+  return q;
+}
+
+void LayoutArena::reset()
+{
+  stats.arenaBytes = used;
+  prevStats = stats;
+  stats = Stats();
+  if(overflow > 0) {
+    capacity = std::max(2*capacity, used + overflow);
+    ::free(buf);
+    buf = (char*)::malloc(capacity);
+  }
+  used = 0;
+  lastBlock = 0;
+  overflow = 0;
+}
+
+// get a context for a sub-layout; memory is reused until releaseLayoutPool() at end of frame
+lay_context SvgGui::acquireLayoutContext()
+{
+  lay_context ctx;
+  if(!layoutPool.empty()) {
+    ctx = layoutPool.back();
+    layoutPool.pop_back();
+    lay_reset_context(&ctx);
+    return ctx;
+  }
+  lay_init_context(&ctx);
+  allocFromArena = true;
+  lay_reserve_items_capacity(&ctx, 64);
+  allocFromArena = false;
+  return ctx;
+}
+
+void SvgGui::releaseLayoutPool()
+{
+  for(lay_context& ctx : layoutPool)
+    lay_destroy_context(&ctx);  // frees any heap blocks
+  layoutPool.clear();
+  layoutArena.reset();
+  const LayoutArena::Stats& st = layoutArena.prevStats;
+  if(debugLayoutAllocs && (st.heapAllocs > 0 || st.arenaAllocs > 0))
+    PLATFORM_LOG("Layout allocations: %d heap, %d arena (%d bytes)\n",
+        st.heapAllocs, st.arenaAllocs, int(st.arenaBytes));
+}
+
+// copy items and rects (e.g. from a pooled context to one that persists across frames)
+static void copyLayoutContext(lay_context* dest, const lay_context* src)
+{
+  lay_reset_context(dest);
+  lay_reserve_items_capacity(dest, src->count);
+  memcpy(dest->items, src->items, src->count*sizeof(lay_item_t));
+  memcpy(dest->rects, src->rects, src->count*sizeof(lay_vec4));
+  dest->count = src->count;
+}
+
+static void snapshotLayoutRects(LayoutTree* tree, lay_id id)
+{
+  lay_context* ctx = &tree->ctx;
+  const lay_scalar* r = (const lay_scalar*)&ctx->rects[id];
+  std::copy(r, r + 4, &tree->prevRects[4*id]);
+  tree->reused[id] = false;
+  for(lay_id child = lay_get_item(ctx, id)->first_child; child != LAY_INVALID_ID; child = lay_next_sibling(ctx, child))
+    snapshotLayoutRects(tree, child);
+}
+
+// save rects of subtree at root (whole tree if root is LAY_INVALID_ID) so that applyLayout can skip unchanged
+//  subtrees; only the items being laid out again are touched, so relayout of a subtree isn't O(tree size)
+static void beginLayoutPass(LayoutTree* tree, lay_id root = LAY_INVALID_ID)
+{
+  lay_context* ctx = &tree->ctx;
+  if(root == LAY_INVALID_ID) {
+    const lay_scalar* rects = (const lay_scalar*)ctx->rects;
+    tree->prevRects.assign(rects, rects + 4*ctx->count);
+    tree->reused.assign(ctx->count, false);
+    return;
+  }
+  if(tree->prevRects.size() < 4*size_t(ctx->count))
+    tree->prevRects.resize(4*size_t(ctx->count));
+  if(tree->reused.size() < size_t(ctx->count))
+    tree->reused.resize(ctx->count, false);
+  snapshotLayoutRects(tree, root);
+}
+
+// lay_arrange sets LAY_BREAK on children of flex-wrap containers, but LAY_BREAK is also read as manual
+//  break (flex-break), so it must be reset before items are run again
+static void resetLayoutBreaks(lay_context* ctx, lay_id id)
+{
+  lay_item_t* item = lay_get_item(ctx, id);
+  item->flags = (item->flags & ~uint32_t(LAY_BREAK)) | ((item->flags & LAYI_FLEXBREAK) ? LAY_BREAK : 0);
+  if(!(item->flags & LAYI_HASWRAP))
+    return;
+  for(lay_id child = item->first_child; child != LAY_INVALID_ID; child = lay_next_sibling(ctx, child))
+    resetLayoutBreaks(ctx, child);
+}
+
 // be wary of trying to refactor this: many branches + reentrant + used multiple places = very complex logic
-static lay_id prepareLayout(lay_context* ctx, Widget* ext)
+// if tree is passed, ctx must be &tree->ctx; existing items are reused, and are not touched at all if the
+//  widget's subtree is unchanged since the last layout
+static lay_id prepareLayout(lay_context* ctx, Widget* ext, LayoutTree* tree = NULL)
 {
   SvgNode* node = ext->node;
-  lay_id id = lay_item(ctx);
+  lay_id id;
+  if(tree && tree->contains(ext)) {
+    id = ext->layoutId();
+    lay_item_t* item = lay_get_item(ctx, id);
+    item->next_sibling = LAY_INVALID_ID;
+    item->flags &= ~uint32_t(LAY_ITEM_INSERTED);
+    if(ext->layoutVarsValid && node->m_dirty == SvgNode::NOT_DIRTY) {
+      resetLayoutBreaks(ctx, id);
+      tree->reused[id] = true;
+      return id;
+    }
+    item->flags = 0;
+    item->first_child = LAY_INVALID_ID;
+    item->size[0] = item->size[1] = 0;
+  }
+  else {
+    id = lay_item(ctx);
+    if(tree) {
+      tree->widgets.resize(id + 1, NULL);
+      tree->widgets[id] = ext;
+      tree->reused.resize(id + 1, false);
+      tree->reused[id] = false;  // id may be reused after ctx->count was reduced
+    }
+  }
   ext->setLayoutId(id);
   //ext->setLayoutTransform(Transform2D());
   if(!ext->layoutVarsValid)
@@ -629,12 +1336,16 @@ static lay_id prepareLayout(lay_context* ctx, Widget* ext)
       if(!child->isVisible() || child->displayMode() == SvgNode::AbsoluteMode)
         continue;
       Widget* w = child->hasExt() ? static_cast<Widget*>(child->ext()) : new Widget(child);
-      w->setLayoutId(-1);  // reset layout id
+      if(!tree)
+        w->setLayoutId(-1);  // reset layout id
+      lay_id childid = prepareLayout(ctx, w, tree);
       // or should we iterate in reverse order?
       if(ext->layContain & Widget::LAYX_REVERSE)
-        lay_push(ctx, id, prepareLayout(ctx, w));  // prepends
+        lay_push(ctx, id, childid);  // prepends
       else
-        lay_insert(ctx, id, prepareLayout(ctx, w));  // appends
+        lay_insert(ctx, id, childid);  // appends
+      if(tree)
+        lay_get_item(ctx, id)->flags |= lay_get_item(ctx, childid)->flags & LAYI_HASWRAP;
     }
 
     if(node->type() == SvgNode::DOC) {
@@ -657,6 +1368,11 @@ static lay_id prepareLayout(lay_context* ctx, Widget* ext)
   lay_set_margins_ltrb(ctx, id, m.left, m.top, m.right, m.bottom);
   lay_set_contain(ctx, id, ext->layContain & LAY_ITEM_BOX_MASK);
   lay_set_behave(ctx, id, ext->layBehave & LAY_ITEM_LAYOUT_MASK);
+  if(tree) {
+    lay_item_t* item = lay_get_item(ctx, id);
+    item->flags |= (ext->layContain & LAY_WRAP) ? LAYI_HASWRAP : 0;
+    item->flags |= (ext->layBehave & LAY_BREAK) ? LAYI_FLEXBREAK : 0;
+  }
 
   if(bbox.isValid()) {
     float w = (ext->layBehave & LAY_HFILL) != LAY_HFILL ? bbox.width() : 0;  //int(bbox.width() + 0.5)
@@ -668,13 +1384,23 @@ static lay_id prepareLayout(lay_context* ctx, Widget* ext)
   return id;
 }
 
-static void applyLayout(lay_context* ctx, Widget* ext)
+// with tree, subtrees reused by prepareLayout which end up with same rect as previous run are skipped
+static void applyLayout(lay_context* ctx, Widget* ext, LayoutTree* tree = NULL, bool reused = false)
 {
   SvgNode* node = ext->node;
-  if(ext->layoutId() < 0)
+  int id = ext->layoutId();
+  if(id < 0 || (tree && !tree->contains(ext)))
     return;
 
-  lay_vec4 r = lay_get_rect(ctx, ext->layoutId());
+  lay_vec4 r = lay_get_rect(ctx, id);
+  if(tree) {
+    reused = reused || tree->reused[id];
+    if(reused && 4*id < int(tree->prevRects.size())) {
+      const lay_scalar* p = &tree->prevRects[4*id];
+      if(r[0] == p[0] && r[1] == p[1] && r[2] == p[2] && r[3] == p[3])
+        return;
+    }
+  }
   Rect dest = Rect::ltwh(r[0], r[1], r[2], r[3]);
 
   if(SvgGui::debugLayout)
@@ -684,7 +1410,7 @@ static void applyLayout(lay_context* ctx, Widget* ext)
     for(SvgNode* child : node->asContainerNode()->children()) {
       if(!child->isVisible() || child->displayMode() == SvgNode::AbsoluteMode || !child->hasExt())
         continue;
-      applyLayout(ctx, static_cast<Widget*>(child->ext()));
+      applyLayout(ctx, static_cast<Widget*>(child->ext()), tree, reused);
     }
   }
   ext->setLayoutBounds(dest);  // previously we did this before iterating over children
@@ -732,11 +1458,13 @@ void Widget::setLayoutBounds(const Rect& dest)
     real w = std::max(real(0), (dest.width() - sw)/tf.xscale());
     real h = std::max(real(0), (dest.height() - sw)/tf.yscale());
     rnode->setRect(Rect::ltwh(r.left, r.top, w, h), -1, -1);  // preserve rounded rect radii
+    node->invalidate(true);  // bounds changed even if layout transform does not
     sx = 1;
     sy = 1;
   }
 
-  m_layoutTransform = Transform2D::translating(dx, dy) *  m_layoutTransform * Transform2D::scaling(sx, sy);
+  // setLayoutTransform() only invalidates bounds if scale changes
+  setLayoutTransform(Transform2D::translating(dx, dy) *  m_layoutTransform * Transform2D::scaling(sx, sy));
   // note that totalTransform() does not include any layout transforms
   //Transform2D totaltf = node->totalTransform();  Dim tsx = totaltf.m11();  Dim tsy = totaltf.m22();
   //m_layoutTransform = Transform2D().translate(-src.left/tsx, -src.top/tsy)
@@ -744,70 +1472,243 @@ void Widget::setLayoutBounds(const Rect& dest)
 
   // If clearing layout bounds every time, use this instead:
   //m_layoutTransform = Transform2D().scale(sx, sy).translate(dx, dy);
-  node->invalidate(true);
 }
 
-// limiting layout: for now, layout can be limited to a subtree by setting the Widget.layoutIsolate flag
-// - we may be able to infer this property in some cases (?), but there are definitely cases where we want
-//  it even though internal changes could theoretically affect global layout
+static bool isAbsPosNode(const SvgNode* node)
+{
+  if(node->hasExt())
+    return static_cast<const Widget*>(node->ext())->isAbsPosNode();
+  return StringRef(node->getStringAttr("position")) == "absolute";
+}
+
+// for each node, children leading to widgets in layoutDirtyWidgets
+typedef std::unordered_map<const SvgNode*, std::vector<const SvgNode*> > LayoutDirtyPaths;
+
+static void buildLayoutDirtyPaths(LayoutDirtyPaths& paths)
+{
+  for(Widget* w : layoutDirtyWidgets) {
+    for(const SvgNode* n = w->node; n->parent(); n = n->parent()) {
+      std::vector<const SvgNode*>& children = paths[n->parent()];
+      if(std::find(children.begin(), children.end(), n) != children.end())
+        break;  // rest of path already added
+      children.push_back(n);
+    }
+  }
+}
+
+// limiting layout: layout can be limited to a subtree by setting the Widget.layoutIsolate flag
+// - there are definitely cases where we want it even though internal changes could theoretically affect
+//  global layout
 // - use sparingly - only needed for a few complex widgets like TextEdit and Slider
-static Widget* findLayoutDirtyRoot(Widget* w)
+// - otherwise, isolation is inferred for containers whose size can't depend on their contents (see below)
+
+// infer that w can be laid out w/o its parent: w must be an <svg> w/ explicit (non-percent, non-fill) size on
+//  both axes, so its size doesn't depend on its contents or on its parent, and position must not depend on
+//  siblings (parent uses box layout or w is the only child); layoutAndDraw falls back to full layout if bounds
+//  of w change anyway.  Fill isn't enough: it pins w to the parent's previous size, which is stale if parent
+//  is sized to its contents (e.g. child container of a menu)
+static bool inferLayoutIsolate(const Widget* w, const Widget* parent)
+{
+  if(!w->layoutVarsValid || !w->node->m_renderedBounds.isValid() || !w->node->asContainerNode())
+    return false;
+  // onPrepareLayout is OK (e.g. ScrollWidget) since <svg> size is fixed, so contents layout doesn't affect size
+  const SvgDocument* doc = w->node->type() == SvgNode::DOC ? static_cast<const SvgDocument*>(w->node) : NULL;
+  if(!doc || doc->width().isPercent() || doc->height().isPercent() || (w->layBehave & LAY_HFILL) == LAY_HFILL
+      || (w->layBehave & LAY_VFILL) == LAY_VFILL)
+    return false;
+  // children of widgets w/ custom layout (e.g. ScrollWidget) aren't laid out in parent bounds
+  if(!(parent->layContain & Widget::LAYX_HASLAYOUT) || parent->onPrepareLayout)
+    return false;
+  if(parent->layContain & LAY_FLEX) {
+    for(const SvgNode* child : parent->node->asContainerNode()->children()) {
+      if(child != w->node && child->isVisible() && child->displayMode() != SvgNode::AbsoluteMode)
+        return false;
+    }
+  }
+  return true;
+}
+
+// Returns true if w must be laid out; otherwise, roots of any dirty layout isolated subtrees are added to
+//  roots so they can be laid out separately (if w has a dirty child which is not isolated, w is the root)
+// if paths is passed, only children on paths to registered widgets are searched, down to the registered
+//  widgets themselves (see SvgGui::trackLayoutDirty)
+static bool findLayoutDirtyRoots(Widget* w, std::vector<Widget*>& roots, const LayoutDirtyPaths* paths = NULL)
 {
   if(w->node->m_dirty == SvgNode::NOT_DIRTY)
-    return NULL;
+    return false;
   if(!w->layoutVarsValid)
-    return w;
+    return true;
   if(w->node->m_dirty == SvgNode::BOUNDS_DIRTY)  // && (w->node->bounds() != w->node->m_renderedBounds || !w->node->isVisible()))
-    return w;
+    return true;
   SvgContainerNode* container = w->node->asContainerNode();
   if(container) {
     if(container->m_removedBounds.isValid())
-      return w;
+      return true;
     // don't descend if contents not subject to layout, but check if bounds have changed (note that this
     //  could be due to change of child, so node might only be CHILD_DIRTY, not BOUNDS dirty)
     if(!(w->layContain & Widget::LAYX_HASLAYOUT) && !w->onPrepareLayout)
-      return w->node->bounds() != w->node->m_renderedBounds ? w : NULL;
-    Widget* dirtyRoot = NULL;
-    for(const SvgNode* child : container->children()) {
+      return w->node->bounds() != w->node->m_renderedBounds;
+    if(paths && w->m_layoutDirtyRegistered)
+      paths = NULL;
+    auto pathit = paths ? paths->find(w->node) : LayoutDirtyPaths::const_iterator();
+    if(paths && pathit == paths->end())
+      return false;
+    size_t nroots = roots.size();
+    auto checkChild = [&](const SvgNode* child) {
       // abs pos nodes are laid out separately
-      if(child->m_dirty != SvgNode::NOT_DIRTY && child->isPaintable() && StringRef(child->getStringAttr("position")) != "absolute") {
+      if(child->m_dirty != SvgNode::NOT_DIRTY && child->isPaintable() && !isAbsPosNode(child)) {
         // a newly shown child (which will be BOUNDS_DIRTY) may not have ext yet
         if(!child->hasExt())
-          return w;
-        Widget* d = findLayoutDirtyRoot(static_cast<Widget*>(child->ext()));
-        // if two children are dirty, or dirty child is not isolated, w is the root
-        if(!d)
-          continue;
-        if(!d->layoutIsolate || dirtyRoot)
-          return w;
-        dirtyRoot = d;
+          return false;
+        Widget* c = static_cast<Widget*>(child->ext());
+        if(findLayoutDirtyRoots(c, roots, paths)) {
+          if(!c->layoutIsolate && !inferLayoutIsolate(c, w))
+            return false;
+          roots.push_back(c);
+        }
       }
+      return true;
+    };
+    bool ok = true;
+    if(paths) {
+      for(const SvgNode* child : pathit->second) {
+        if(!(ok = checkChild(child)))
+          break;
+      }
+    }
+    else {
+      for(const SvgNode* child : container->children()) {
+        if(!(ok = checkChild(child)))
+          break;
+      }
+    }
+    if(!ok)
+      roots.resize(nroots);
+    return !ok;
+  }
+  return false;
+}
+
+// persistent layout tree of Window or abs pos widget containing ext, if any
+static LayoutTree* findLayoutTree(const Widget* ext)
+{
+  for(const SvgNode* n = ext->node; n; n = n->parent()) {
+    Widget* w = static_cast<Widget*>(n->ext(false));
+    if(w && w->widgetClass() != Widget::WidgetClass) {
+      LayoutTree* tree = static_cast<AbsPosWidget*>(w)->layoutTree.get();
+      return tree && tree->contains(ext) ? tree : NULL;
     }
-    return dirtyRoot;
   }
   return NULL;
 }
 
+// get persistent layout tree for a Window or abs pos widget and start a new layout run
+static LayoutTree* beginLayoutTree(AbsPosWidget* ext)
+{
+  if(!ext->layoutTree)
+    ext->layoutTree.reset(new LayoutTree);
+  LayoutTree* tree = ext->layoutTree.get();
+  // start over if too many items have been orphaned (by deleted widgets, etc.)
+  if(SvgGui::debugLayout || tree->ctx.count > 2*tree->rebuildCount + 256)
+    tree->clear();
+  beginLayoutPass(tree);
+  return tree;
+}
+
+static void endLayoutTree(LayoutTree* tree)
+{
+  if(tree->rebuildCount == 0)
+    tree->rebuildCount = tree->ctx.count;
+}
+
 // for sub-layout of a container; currently only used by ScrollWidget
+// When called re-entrantly (i.e. from onPrepareLayout or onApplyLayout), the result is cached and reused if
+//  the same bbox is passed again, contents are not dirty, and contents layoutGen is unchanged, in which case
+//  only applyLayout is repeated; contents must not be dirty even within the same top-level layout pass since
+//  callbacks (e.g. onApplyLayout for text elision) can change content w/o bumping layoutGen
 void SvgGui::layoutWidget(Widget* contents, const Rect& bbox)
 {
-  lay_context ctx;
-  lay_init_context(&ctx);
-  //lay_reserve_items_capacity(&ctx, 1024);
+  bool nested = layoutDepth > 0;
+  if(!nested)
+    contents->bumpLayoutGen();  // invalidate cached layouts of ancestors
+  Widget::LayoutCache* cache = contents->m_layoutCache.get();
+  if(nested && cache && cache->bbox == bbox && cache->gen == contents->layoutGen && !debugLayout
+      && contents->node->m_dirty == SvgNode::NOT_DIRTY) {
+    ++layoutDepth;
+    applyLayout(&cache->ctx, contents);
+    --layoutDepth;
+    cache->gen = contents->layoutGen;  // applyLayout may call layoutWidget for descendants
+    return;
+  }
+  ++layoutDepth;
+
+  // if contents is part of a persistent layout tree, lay it out in place to preserve items
+  LayoutTree* tree = persistentLayout ? findLayoutTree(contents) : NULL;
+  if(tree) {
+    lay_context* ctx = &tree->ctx;
+    beginLayoutPass(tree, contents->layoutId());
+    lay_item_t* item = lay_get_item(ctx, contents->layoutId());
+    lay_id next = item->next_sibling;
+    uint32_t inserted = item->flags & LAY_ITEM_INSERTED;
+    lay_id contents_id = prepareLayout(ctx, contents, tree);
+    // temporary container item, removed after run
+    lay_id container_id = lay_item(ctx);
+    lay_set_margins_ltrb(ctx, container_id, bbox.left, bbox.top, 0, 0);
+    lay_set_size_xy(ctx, container_id, bbox.width(), bbox.height());
+    lay_get_item(ctx, container_id)->first_child = contents_id;
+    lay_run_item(ctx, container_id);
+    ctx->count = container_id;
+    item = lay_get_item(ctx, contents_id);
+    item->next_sibling = next;
+    item->flags |= inserted;
+    applyLayout(ctx, contents, tree);
+    --layoutDepth;
+    return;
+  }
+
+  lay_context ctx = acquireLayoutContext();
   lay_id container_id = lay_item(&ctx);
   lay_set_margins_ltrb(&ctx, container_id, bbox.left, bbox.top, 0, 0);
   lay_set_size_xy(&ctx, container_id, bbox.width(), bbox.height());
   lay_id contents_id = prepareLayout(&ctx, contents);
   lay_insert(&ctx, container_id, contents_id);
   // lay_run_context resets LAY_BREAK flags
+  allocFromArena = true;  // for LAY_SOA scratch
   lay_run_item(&ctx, 0);  //lay_run_context(&ctx);
+  allocFromArena = false;
   applyLayout(&ctx, contents);
-  lay_destroy_context(&ctx);
+  --layoutDepth;
+  if(nested && !debugLayout) {
+    if(!cache)
+      contents->m_layoutCache.reset(cache = new Widget::LayoutCache);
+    copyLayoutContext(&cache->ctx, &ctx);  // cache is kept across frames so can't use arena
+    cache->bbox = bbox;
+    cache->gen = contents->layoutGen;
+  }
+  releaseLayoutContext(ctx);
 }
 
 // for layout of a top-level window; handles position=absolute nodes
 void SvgGui::layoutWindow(Window* win, const Rect& bbox)
 {
+  ++layoutDepth;
+  if(persistentLayout) {
+    LayoutTree* tree = beginLayoutTree(win);
+    lay_context* ctx = &tree->ctx;
+    if(ctx->count == 0) {
+      lay_item(ctx);  // root
+      tree->widgets.push_back(NULL);
+      tree->reused.push_back(false);
+    }
+    lay_get_item(ctx, 0)->first_child = LAY_INVALID_ID;
+    lay_set_size_xy(ctx, 0, bbox.width(), bbox.height());
+    lay_insert(ctx, 0, prepareLayout(ctx, win, tree));
+    lay_run_context(ctx);
+    applyLayout(ctx, win, tree);
+    endLayoutTree(tree);
+    --layoutDepth;
+    return;
+  }
   //lay_reset_context(ctx);
   // top-level layout
   lay_context* ctx = &layoutCtx;
@@ -818,6 +1719,7 @@ void SvgGui::layoutWindow(Window* win, const Rect& bbox)
   lay_run_context(ctx);
   applyLayout(ctx, win);
   lay_reset_context(ctx);
+  --layoutDepth;
 }
 
 void SvgGui::layoutAbsPosWidget(AbsPosWidget* ext)
@@ -835,9 +1737,20 @@ void SvgGui::layoutAbsPosWidget(AbsPosWidget* ext)
   //Dim gs = win->gui()->globalScale;
   //layoutWidget(ext, ext->maxWidth*gs, ext->maxHeight*gs);
 
-  prepareLayout(ctx, ext);
-  lay_run_item(ctx, 0);  //lay_run_context(ctx); - this resets LAY_BREAK flags
-  applyLayout(ctx, ext);
+  ++layoutDepth;
+  if(persistentLayout) {
+    LayoutTree* tree = beginLayoutTree(ext);
+    lay_id id = prepareLayout(&tree->ctx, ext, tree);
+    lay_run_item(&tree->ctx, id);
+    applyLayout(&tree->ctx, ext, tree);
+    endLayoutTree(tree);
+  }
+  else {
+    prepareLayout(ctx, ext);
+    lay_run_item(ctx, 0);  //lay_run_context(ctx); - this resets LAY_BREAK flags
+    applyLayout(ctx, ext);
+  }
+  --layoutDepth;
 
   // for now, we assume left and right are never both set, nor both top and bottom!
   // note that nodes in absPosNodes always have a parent
@@ -893,13 +1806,10 @@ void SvgGui::showMenu(Widget* menu)
 // parent_menu can be used to open context menu on menu item w/o closing menu
 // make_pressed = false can be passed if opening menu on a release event (in which case pressedWidget will be
 //  immediately cleared anyway)
-void SvgGui::showContextMenu(Widget* menu, const Point& p, const Widget* parent_menu, bool make_pressed)
+void SvgGui::showContextMenu(AbsPosWidget* menu, const Point& p, const Widget* parent_menu, bool make_pressed)
 {
   Rect parentBounds = menu->node->parent()->bounds();
-  menu->node->setAttribute("left", fstring("%g", p.x - parentBounds.left).c_str());
-  menu->node->setAttribute("top", fstring("%g", p.y - parentBounds.top).c_str());
-  //menu->offsetLeft = SvgLength(p.x - parentBounds.left);
-  //menu->offsetTop = SvgLength(p.y - parentBounds.top);
+  menu->setOffsets(p.x - parentBounds.left, p.y - parentBounds.top);
   if(!menu->isVisible()) {
     closeMenus(parent_menu);
     //openedContextMenu = menu;
@@ -937,7 +1847,7 @@ void SvgGui::setupRightClick(Widget* itemext, const std::function<void(SvgGui*,
       return true;
     }
     return false;
-  });
+  }, Widget::PRESS_EVENTS);
 }
 
 // cache unused SDL_Windows?
@@ -1315,6 +2225,109 @@ Widget* SvgGui::findNextFocusable(Widget* parent, Widget* curr, bool reverse)
   return NULL;
 }
 
+// add widgets in subtree of node to grid in paint order; later is union of bounds of non-widget nodes drawn
+//  after subtree (other than its descendants); clip is intersection of bounds of enclosing <svg> nodes (node
+//  bounds aren't clipped, e.g. scrolled out contents of ScrollWidget) and is applied to stored bounds
+static void buildHitTestGrid(HitTestGrid* grid, const SvgNode* node, Rect later, const Rect& clip)
+{
+  const SvgContainerNode* container = node->asContainerNode();
+  if(!container || !clip.isValid())
+    return;
+  std::vector<const SvgNode*> children;
+  for(const SvgNode* child : container->children()) {
+    if(child->isVisible() && !isAbsPosNode(child))
+      children.push_back(child);
+  }
+  std::vector<Rect> laters(children.size());
+  for(size_t ii = children.size(); ii-- > 0;) {
+    laters[ii] = later;
+    if(!children[ii]->hasExt())
+      later.rectUnion(Rect(children[ii]->bounds()).rectIntersect(clip));
+  }
+  for(size_t ii = 0; ii < children.size(); ++ii) {
+    const SvgNode* child = children[ii];
+    Rect b = Rect(child->bounds()).rectIntersect(clip);
+    if(child->hasExt() && b.isValid()) {
+      unsigned int idx = grid->entries.size();
+      grid->entries.push_back({static_cast<Widget*>(child->ext()), b, laters[ii].intersects(b)});
+      Rect r = Rect(b).rectIntersect(grid->bbox);
+      if(r.isValid()) {
+        int x0 = int((r.left - grid->bbox.left)/grid->cellSize), y0 = int((r.top - grid->bbox.top)/grid->cellSize);
+        int x1 = std::min(grid->nx - 1, int((r.right - grid->bbox.left)/grid->cellSize));
+        int y1 = std::min(grid->ny - 1, int((r.bottom - grid->bbox.top)/grid->cellSize));
+        for(int y = y0; y <= y1; ++y) {
+          for(int x = x0; x <= x1; ++x)
+            grid->cells[y*grid->nx + x].push_back(idx);
+        }
+      }
+    }
+    buildHitTestGrid(grid, child, laters[ii], child->type() == SvgNode::DOC ? b : clip);
+  }
+}
+
+// true if bounds of any node in window could have changed (or a node was removed) since last frame
+static bool hitTestBoundsDirty(const SvgNode* node)
+{
+  if(node->m_dirty == SvgNode::BOUNDS_DIRTY)
+    return true;
+  const SvgContainerNode* container = node->asContainerNode();
+  if(!container)
+    return false;
+  if(container->m_removedBounds.isValid())
+    return true;
+  for(const SvgNode* child : container->children()) {
+    if(child->m_dirty != SvgNode::NOT_DIRTY && hitTestBoundsDirty(child))
+      return true;
+  }
+  return false;
+}
+
+// widgetAt() w/o searching whole window: topmost widget (in paint order) whose bounds contain p is found with
+//  HitTestGrid, then nodeAt() is called on it, falling back to widgets below it (which include its ancestors)
+//  if nothing is hit; returns false if grid can't be used.  Grid is dropped if any bounds in window change and
+//  rebuilt from scratch (one allocation per cell) on next use, rather than updated incrementally, so we don't
+//  build it while bounds are changing every frame (e.g. animation or kinetic scrolling), when it would likely
+//  be dropped before next use - whole window is searched instead
+static bool hitTestGrid(Window* win, Point p, SvgNode** hit)
+{
+  if(win->node->m_dirty != SvgNode::NOT_DIRTY)
+    return false;  // bounds may be stale
+  HitTestGrid* grid = win->hitGrid.get();
+  if(!grid) {
+    const SvgGui* gui = win->gui();
+    if(win->boundsDirtyRun > 1 && win->boundsDirtyFrame == drawFrameCount
+        && mSecSinceEpoch() - gui->lastFrameTime < 2*std::max(gui->frameInterval, 16))
+      return false;
+    win->hitGrid.reset(grid = new HitTestGrid);
+    grid->bbox = win->node->bounds();
+    if(!grid->bbox.isValid())
+      return false;
+    static constexpr int MAX_CELLS = 64;
+    grid->cellSize = std::max(grid->cellSize, std::max(grid->bbox.width(), grid->bbox.height())/MAX_CELLS);
+    grid->nx = std::max(1, int(std::ceil(grid->bbox.width()/grid->cellSize)));
+    grid->ny = std::max(1, int(std::ceil(grid->bbox.height()/grid->cellSize)));
+    grid->cells.resize(grid->nx*grid->ny);
+    buildHitTestGrid(grid, win->node, Rect(), grid->bbox);
+  }
+  if(!grid->bbox.contains(p))
+    return false;
+  int x = std::min(grid->nx - 1, int((p.x - grid->bbox.left)/grid->cellSize));
+  int y = std::min(grid->ny - 1, int((p.y - grid->bbox.top)/grid->cellSize));
+  const std::vector<unsigned int>& cell = grid->cells[y*grid->nx + x];
+  for(auto it = cell.rbegin(); it != cell.rend(); ++it) {
+    const HitTestGrid::Entry& entry = grid->entries[*it];
+    if(!entry.bounds.contains(p))
+      continue;
+    if(entry.occluded)
+      return false;
+    Widget* w = entry.widget;
+    *hit = w->containerNode() ? w->containerNode()->nodeAt(p, false) : w->node;
+    if(*hit)
+      return true;
+  }
+  return false;  // fall back to searching from window
+}
+
 Widget* SvgGui::widgetAt(Window* win, Point p)
 {
   // absolutely positioned nodes may extend outside the bounds of the window (e.g. combo menu in modal)
@@ -1330,7 +2343,7 @@ Widget* SvgGui::widgetAt(Window* win, Point p)
   }
 
   // visual_only = false; alternative would be to first call with true, then w/ false if NULL result
-  if(!node && win->winBounds().contains(p + win->winBounds().origin()))
+  if(!node && win->winBounds().contains(p + win->winBounds().origin()) && !hitTestGrid(win, p, &node))
     node = win->containerNode()->nodeAt(p, false);  //documentNode()
   //if(node) {
   //  Rect r = node->bounds();
@@ -1401,7 +2414,8 @@ void SvgGui::updateGestures(SDL_Event* event)
 
 Uint32 SvgGui::longPressDelayMs = 700;  // 500ms is typical value on Android (and iOS?)
 
-bool SvgGui::sdlTouchEvent(SDL_Event* event)
+// convert touch event position from input coords to relative units in win, in place
+void SvgGui::touchToWindowCoords(SDL_Event* event, const Window* win)
 {
   // SDL's built-in touch input handling normalizes coordinates by dividing by window size, but if custom
   //  input handling is used (e.g. to add stylus support), this may not be the case
@@ -1409,22 +2423,34 @@ bool SvgGui::sdlTouchEvent(SDL_Event* event)
   int w, h;
   SDL_GetWindowSize(windows.front()->sdlWindow, &w, &h);
   event->tfinger.x *= w;
-  event->tfinger.x *= h;
+  event->tfinger.y *= h;
 #endif
-  Window* win = windows.front()->modalOrSelf();
-  // convert p to relative units
   Point p = Point(event->tfinger.x, event->tfinger.y)*inputScale - win->winBounds().origin();
-
   event->tfinger.x = p.x;
   event->tfinger.y = p.y;
   event->tfinger.dx *= inputScale;  // touch area major, minor axes - used for palm rejection
   event->tfinger.dy *= inputScale;
+}
+
+bool SvgGui::sdlTouchEvent(SDL_Event* event)
+{
+  Window* win = windows.front()->modalOrSelf();
+  touchToWindowCoords(event, win);
+  Point p(event->tfinger.x, event->tfinger.y);
   if(event->type == SDL_FINGERDOWN && touchPoints.empty()) {
     pressEvent = *event;
     event = &pressEvent;  // make sure possible modification of fingerId below gets applied to pressEvent!
   }
   // handle single finger gestures (handling multitouch gestures is left to user)
-  if(!multiTouchActive && (touchPoints.empty() || event->tfinger.fingerId == touchPoints.back().id))
+  bool gestures = !multiTouchActive && (touchPoints.empty() || event->tfinger.fingerId == touchPoints.back().id);
+  if(event == coalescedEvent) {
+    for(SDL_Event& prev : motionHistory) {
+      touchToWindowCoords(&prev, win);
+      if(gestures)
+        updateGestures(&prev);
+    }
+  }
+  if(gestures)
     updateGestures(event);
   // allow platform interface to send mouse events as finger events
   if(event->tfinger.touchId == SDL_TOUCH_MOUSEID)
@@ -1600,6 +2626,20 @@ bool SvgGui::sdlMouseEvent(SDL_Event* event)
   else if(event->type == SDL_MOUSEMOTION) {
     fevent.tfinger.type = SDL_FINGERMOTION;
     fevent.tfinger.fingerId = event->motion.state;
+    if(event == coalescedEvent) {
+      for(SDL_Event& prev : motionHistory) {
+        Point pp(prev.motion.x, prev.motion.y);
+#ifndef SVGGUI_MULTIWINDOW
+        pp = pp*inputScale - win->winBounds().origin();
+#endif
+        SDL_Event fprev = fevent;
+        fprev.tfinger.timestamp = prev.common.timestamp;
+        fprev.tfinger.x = pp.x;
+        fprev.tfinger.y = pp.y;
+        prev = fprev;
+        updateGestures(&prev);
+      }
+    }
   }
   updateGestures(&fevent);
   return sendEventFilt(win, widgetAt(win, p), &fevent);
@@ -1613,8 +2653,41 @@ bool SvgGui::isFocusedWidgetEvent(SDL_Event* event)
       || event->type == SvgGui::FOCUS_GAINED || event->type == SvgGui::FOCUS_LOST;
 }
 
+static bool isSameMotionPointer(const SDL_Event& a, const SDL_Event& b)
+{
+  if(a.type != b.type)
+    return false;
+  if(a.type == SDL_MOUSEMOTION)
+    return a.motion.which == b.motion.which && a.motion.windowID == b.motion.windowID && a.motion.state == b.motion.state;
+  return a.tfinger.touchId == b.tfinger.touchId && a.tfinger.fingerId == b.tfinger.fingerId;
+}
+
+// send last pending motion event w/ earlier ones in motionHistory
+bool SvgGui::flushMotion()
+{
+  if(pendingMotion.empty())
+    return false;
+  SDL_Event event = pendingMotion.back();
+  pendingMotion.pop_back();
+  motionHistory.swap(pendingMotion);
+  coalescedEvent = &event;
+  bool res = event.type == SDL_MOUSEMOTION ? sdlMouseEvent(&event) : sdlTouchEvent(&event);
+  coalescedEvent = NULL;
+  motionHistory.clear();
+  return res;
+}
+
 bool SvgGui::sdlEvent(SDL_Event* event)
 {
+  if(coalesceMotion && (event->type == SDL_FINGERMOTION || event->type == SDL_MOUSEMOTION)) {
+    if(!pendingMotion.empty() && !isSameMotionPointer(pendingMotion.back(), *event))
+      flushMotion();
+    pendingMotion.push_back(*event);
+    return true;
+  }
+  // preserve order of events
+  flushMotion();
+
   if(event->type == SDL_FINGERDOWN || event->type == SDL_FINGERMOTION
       || event->type == SDL_FINGERUP || event->type == SVGGUI_FINGERCANCEL)
     return sdlTouchEvent(event);
@@ -1643,9 +2716,25 @@ bool SvgGui::sdlEvent(SDL_Event* event)
   return false;
 }
 
+unsigned int EventFilter::generation = 1;
+
+// result is cached for widget and its ancestors until EventFilter::generation changes, so sendEventFilt()
+//  doesn't need to search ancestors for filters in the (usual) case that there are none
+bool Widget::hasFilterChain()
+{
+  if(filterChainGen != EventFilter::generation) {
+    Widget* p = widgetClass() != AbsPosWidgetClass ? parent() : NULL;
+    filterChain = bool(eventFilter) || (p && p->hasFilterChain());
+    filterChainGen = EventFilter::generation;
+  }
+  return filterChain;
+}
+
 bool SvgGui::sendEventFilt(Window* win, Widget* widget, SDL_Event* event)
 {
   Widget* filtwidget = widget ? widget : win;
+  if(!filtwidget || !filtwidget->hasFilterChain())
+    return sendEvent(win, widget, event);
   while(filtwidget) {
     if(filtwidget->eventFilter)  //&& filtwidget != pressedWidget
       filterWidgets.push_back(filtwidget);
@@ -1750,23 +2839,320 @@ bool SvgGui::sendEvent(Window* win, Widget* widget, SDL_Event* event)
 //  right track I think (replacing Widget w/ Window for abs pos nodes, but leaving in parent doc structure),
 //  but problems arose due to abs pos node bounds origin being at (0,0) since they now had winBounds
 // other issues included modal behavior (yes or no?) and need for two versions of Widget::window()
-Rect SvgGui::layoutAndDraw(Painter* painter)
+// each dirty rect is drawn in a separate pass, so merge rects if bounding rect isn't much larger than the
+//  sum of their areas (overhead of a pass is taken to be the cost of drawing this many pixels)
+static constexpr real dirtyRectOverhead = 128*128;
+
+static real rectArea(const Rect& r) { return r.width()*r.height(); }
+
+// add r to list of disjoint dirty rects, merging rects as needed
+static void addDirtyRect(std::vector<Rect>& rects, Rect r, size_t maxrects)
+{
+  if(!r.isValid())
+    return;
+  for(size_t ii = 0; ii < rects.size();) {
+    Rect u = Rect(rects[ii]).rectUnion(r);
+    if(rects[ii].intersects(r) || rectArea(u) <= rectArea(rects[ii]) + rectArea(r) + dirtyRectOverhead) {
+      r = u;
+      rects.erase(rects.begin() + ii);
+      ii = 0;  // merged rect may now intersect rects already checked
+    }
+    else
+      ++ii;
+  }
+  rects.push_back(r);
+  if(rects.size() <= std::max(maxrects, size_t(1)))
+    return;
+  // too many rects - merge pair with smallest increase in area
+  size_t mi = 0, mj = 1;
+  real mincost = -1;
+  for(size_t ii = 0; ii < rects.size(); ++ii) {
+    for(size_t jj = ii + 1; jj < rects.size(); ++jj) {
+      real cost = rectArea(Rect(rects[ii]).rectUnion(rects[jj])) - rectArea(rects[ii]) - rectArea(rects[jj]);
+      if(mincost < 0 || cost < mincost) {
+        mincost = cost;
+        mi = ii;  mj = jj;
+      }
+    }
+  }
+  Rect u = Rect(rects[mi]).rectUnion(rects[mj]);
+  rects.erase(rects.begin() + mj);
+  rects.erase(rects.begin() + mi);
+  addDirtyRect(rects, u, maxrects);
+}
+
+// add dirty rects of node, splitting dirty rect of a container with only dirty children into rects for each
+//  child so that, e.g., a blinking cursor and a clock in opposite corners don't cause a full window redraw
+// if skipAbsPos is set, abs pos nodes (which are handled separately) are excluded
+static void addDirtyRects(std::vector<Rect>& rects, SvgNode* node, const Point& origin, size_t maxrects,
+    bool skipAbsPos = false)
+{
+  SvgContainerNode* container = node->asContainerNode();
+  if((maxrects > 1 || skipAbsPos) && container && node->m_dirty == SvgNode::CHILD_DIRTY) {
+    if(container->m_removedBounds.isValid())
+      addDirtyRect(rects, Rect(container->m_removedBounds).translate(origin), maxrects);
+    for(SvgNode* child : container->children()) {
+      if(child->m_dirty != SvgNode::NOT_DIRTY && !(skipAbsPos && isAbsPosNode(child)))
+        addDirtyRects(rects, child, origin, maxrects, skipAbsPos);
+    }
+  }
+  else if(node->m_dirty != SvgNode::NOT_DIRTY) {
+    Rect r = SvgPainter::calcDirtyRect(node);
+    if(r.isValid())
+      addDirtyRect(rects, r.translate(origin), maxrects);
+  }
+}
+
+// Scroll by blit: instead of redrawing contents translated by dr (in unscaled coords) inside viewport, shift the
+//  previously rendered pixels in next frame and only draw the exposed area; caller must translate contents
+//  layout transform (and cached bounds) and mark other changes (e.g. scroll handle) dirty as usual.  If the
+//  pixels can't be shifted (e.g. because painter isn't software, anything drawn later overlaps viewport, or
+//  viewport has no opaque background rect), contents are marked dirty in next frame.  Returns false if contents must be marked dirty immediately.
+bool SvgGui::scrollPixels(Widget* viewport, Widget* contents, Point dr)
+{
+  if(!contents->node->cachedBounds().isValid())
+    return false;
+  for(PendingScroll& ps : pendingScrolls) {
+    if(ps.contents == contents) {
+      ps.dr += dr;
+      return true;
+    }
+  }
+  pendingScrolls.push_back({viewport, contents, dr});
+  return true;
+}
+
+// shift pixels of scrolled contents in painter target image and add exposed rects to dirty
+bool SvgGui::shiftScrolledPixels(Painter* painter, Widget* viewport, Widget* contents, Point dr, std::vector<Rect>& dirty)
 {
+  Image* target = painter->targetImage;
+  Window* win = viewport->window();
+  if(painter->usesGPU() || !target || fullRedraw || debugDirty || underlay || !win || win != windows.back())
+    return false;
+  if(contents->node->m_dirty != SvgNode::NOT_DIRTY || viewport->node->m_dirty > SvgNode::CHILD_DIRTY)
+    return false;
+  // shifted pixels must be integral
+  real dx = dr.x*paintScale, dy = dr.y*paintScale;
+  int idx = int(std::round(dx)), idy = int(std::round(dy));
+  if(std::abs(dx - idx) > 1E-3 || std::abs(dy - idy) > 1E-3)
+    return false;
+  Rect view = viewport->node->bounds();
+  auto paintedBounds = [](SvgNode* n){
+    Rect b = n->bounds();
+    Widget* w = n->hasExt() ? static_cast<Widget*>(n->ext(false)) : NULL;
+    if(w && w->m_shadow)
+      b.rectUnion(w->m_shadow->bounds(b));
+    return b;
+  };
+  for(AbsPosWidget* w : win->absPosNodes) {
+    if(paintedBounds(w->node).intersects(view))
+      return false;
+  }
+  // nothing drawn after viewport may overlap it, since those pixels would be shifted too
+  for(SvgNode* n = viewport->node; n != win->node && n->parent(); n = n->parent()) {
+    bool after = false;
+    for(SvgNode* sibling : n->parent()->children()) {
+      if(after && sibling->isVisible() && sibling->displayMode() != SvgNode::AbsoluteMode
+          && paintedBounds(sibling).intersects(view))
+        return false;
+      after = after || sibling == n;
+    }
+  }
+  // whatever shows through contents must be uniform, so an opaque rect must cover viewport under contents (a
+  //  translucent background would show non-uniform pixels from ancestors)
+  bool opaquebg = findOccluder(contents->node, view) != NULL;
+  for(SvgNode* child : viewport->containerNode()->children()) {
+    if(opaquebg || child == contents->node)
+      break;
+    Rect opaque = child->isVisible() ? opaqueRect(child) : Rect();
+    opaquebg = opaque.isValid() && opaque.contains(view);
+  }
+  if(!opaquebg)
+    return false;
+  // only shift pixels entirely inside viewport
+  Point origin = win->winBounds().origin();
+  Rect vpx = Rect(view).translate(origin).scale(paintScale);
+  Rect inner = Rect::ltrb(std::ceil(vpx.left), std::ceil(vpx.top), std::floor(vpx.right), std::floor(vpx.bottom));
+  inner.rectIntersect(Rect::wh(target->width, target->height));
+  if(!inner.isValid() || std::abs(idx) >= inner.width() || std::abs(idy) >= inner.height())
+    return false;
+
+  Rect dest = Rect(inner).translate(idx, idy).rectIntersect(inner);
+  int x0 = int(dest.left), w = int(dest.width());
+  int y0 = int(dest.top), y1 = int(dest.bottom);
+  unsigned char* pixels = target->bytes();
+  size_t stride = size_t(target->width)*4;
+  // iterate so that rows are read before being overwritten
+  for(int ii = 0; ii < y1 - y0; ++ii) {
+    int y = idy > 0 ? y1 - 1 - ii : y0 + ii;
+    memmove(pixels + y*stride + x0*4, pixels + (y - idy)*stride + (x0 - idx)*4, size_t(w)*4);
+  }
+
+  // exposed area (plus partial pixels at edges of viewport) must be drawn
+  Rect shifted = Rect(dest).scale(1/paintScale).translate(-origin.x, -origin.y);
+  addDirtyRect(dirty, Rect::ltrb(view.left, view.top, view.right, shifted.top).translate(origin), maxDirtyRects);
+  addDirtyRect(dirty, Rect::ltrb(view.left, shifted.bottom, view.right, view.bottom).translate(origin), maxDirtyRects);
+  addDirtyRect(dirty, Rect::ltrb(view.left, shifted.top, shifted.left, shifted.bottom).translate(origin), maxDirtyRects);
+  addDirtyRect(dirty, Rect::ltrb(shifted.right, shifted.top, view.right, shifted.bottom).translate(origin), maxDirtyRects);
+  // other children of viewport (e.g. scroll handle) were shifted along with contents
+  for(SvgNode* child : viewport->containerNode()->children()) {
+    if(child == contents->node || !child->isVisible())
+      continue;
+    addDirtyRect(dirty, Rect(child->m_renderedBounds).translate(dr).rectIntersect(view).translate(origin), maxDirtyRects);
+    addDirtyRect(dirty, Rect(child->bounds()).rectIntersect(view).translate(origin), maxDirtyRects);
+  }
+  translateRenderedBounds(contents->node, dr);
+  return true;
+}
+
+// dirty flags propagate up to document, so only window nodes need to be checked; only windows which
+//  layoutAndDraw() lays out (i.e. not beneath a window covering the screen) are considered, since it leaves
+//  others dirty (and widgets in them registered as layout dirty)
+bool SvgGui::needsFrame() const
+{
+  if(frameRequested || closedWindowBounds.isValid() || closedLayerBounds.isValid() || !pendingScrolls.empty()
+      || !pendingMotion.empty())
+    return true;
+  if(windows.empty())
+    return false;
+  Rect screenRect = windows.front()->winBounds();
+  size_t layoutidx = windows.size();
+  while(layoutidx > 0) {
+    const Window* win = windows[--layoutidx];
+    if(win->node->m_dirty != SvgNode::NOT_DIRTY)
+      return true;
+    if(win->winBounds().contains(screenRect))
+      break;
+  }
+  for(Widget* w : layoutDirtyWidgets) {
+    Window* win = w->window();
+    if(win && std::find(windows.begin() + layoutidx, windows.end(), win) != windows.end())
+      return true;
+  }
+  return false;
+}
+
+// if a frame is needed but previous frame was less than frameInterval ago, wait until interval has passed so
+//  that multiple events (e.g. high rate pen input) are coalesced into one frame; returns a time in the past
+//  if something is already due
+Timestamp SvgGui::nextDeadline() const
+{
+  Timestamp deadline = timers.empty() ? MAX_TIMESTAMP : timers.front().nextTick;
+  if(needsFrame())
+    deadline = std::min(deadline, lastFrameTime + frameInterval);
+  return deadline;
+}
+
+Rect SvgGui::layoutAndDraw(Painter* painter, std::vector<Rect>* dirtyRects)
+{
+  // motion events coalesced since last frame must be sent before drawing it
+  flushMotion();
+
   Rect layoutDirtyRect;
-  Rect dirty = closedWindowBounds;
-  closedWindowBounds = Rect();
+  std::vector<Rect> dirty;
+  ++drawFrameCount;
+  frameImages.clear();
+  lastFrameTime = mSecSinceEpoch();
+  frameRequested = false;
   Rect screenRect = windows.front()->winBounds();  // for single window case
 
+  // compositing layers: content beneath the first visible layer (AbsPosWidget::compositeLayer) is drawn to an
+  //  offscreen underlay, which is copied to screen before drawing layers (and anything above them), so that
+  //  showing, hiding, or moving a layer doesn't redraw content beneath it; only supported for software
+  //  painter.  Underlay is freed once no layer is visible; when a layer is shown again, it is copied from
+  //  the screen image instead of being drawn from scratch
+  size_t layerWin = windows.size();
+  int layerAbs = -1;  // index in absPosNodes of first layer, or -1 if window itself is layer
+#ifdef NO_PAINTER_SW
+  bool layered = false;
+#else
+  bool layered = !painter->usesGPU();
+#endif
+  if(layered) {
+    for(size_t ii = 0; ii < windows.size() && layerWin == windows.size(); ++ii) {
+      if(windows[ii]->compositeLayer)
+        layerWin = ii;
+      for(size_t jj = 0; layerWin == windows.size() && jj < windows[ii]->absPosNodes.size(); ++jj) {
+        if(windows[ii]->absPosNodes[jj]->compositeLayer) {
+          layerWin = ii;
+          layerAbs = int(jj);
+        }
+      }
+    }
+    // if bottom window is itself a layer, there is nothing beneath it
+    layered = layerWin < windows.size() && (layerWin > 0 || layerAbs >= 0);
+  }
+  if(!layered && underlay) {
+    underlay.reset();
+    underlayPainter.reset();
+    underlayNodes.clear();
+  }
+  if(!layered)
+    underlayScale = paintScale;  // scale of screen image for underlay snapshot
+  // is window (jj = -1) or abs pos node drawn over underlay?
+  auto isOverlay = [&](size_t ii, int jj, const AbsPosWidget* w){
+    return layered && (w->compositeLayer || ii > layerWin || (ii == layerWin && (layerAbs < 0 || jj >= layerAbs)));
+  };
+  std::vector<Rect> underlayDirty;
+  std::vector<Rect>& closedDirty = layered ? underlayDirty : dirty;
+  addDirtyRect(closedDirty, closedWindowBounds, maxDirtyRects);
+  addDirtyRect(dirty, closedLayerBounds, maxDirtyRects);
+  closedWindowBounds = Rect();
+  closedLayerBounds = Rect();
+
+  // shift pixels of scrolled contents if possible, otherwise fall back to redrawing them
+  for(const PendingScroll& ps : pendingScrolls) {
+    if(layered || !shiftScrolledPixels(painter, ps.viewport, ps.contents, ps.dr, dirty))
+      ps.contents->node->setDirty(SvgNode::PIXELS_DIRTY);
+  }
+  pendingScrolls.clear();
+
+  LayoutDirtyPaths dirtyPaths;
+  const LayoutDirtyPaths* paths = trackLayoutDirty && !debugLayout ? &dirtyPaths : NULL;
+  if(paths)
+    buildLayoutDirtyPaths(dirtyPaths);
+
+  // lay out top (Window or abs pos widget) if needed, otherwise lay out each dirty layout isolated subtree
+  //  separately; returns union of bounds of layout roots for debugDirty
+  std::vector<Widget*> dirtyRoots;
+  auto layoutDirty = [&](AbsPosWidget* top, bool full) {
+    dirtyRoots.clear();
+    if(full || findLayoutDirtyRoots(top, dirtyRoots, paths))
+      dirtyRoots.assign(1, top);
+    for(Widget* root : dirtyRoots) {
+      if(root == top)
+        break;
+      Rect prev = root->node->m_renderedBounds;
+      // bounds() could include newly shown widgets that have never been laid out, so use renderedBounds
+      layoutWidget(root, root->parent()->node->m_renderedBounds);  // bounds());
+      // isolated subtree is laid out without its parent, so fall back to full layout if its size changes (or
+      //  position, if isolation was inferred)
+      Rect b = root->node->bounds();
+      bool moved = !root->layoutIsolate && (std::abs(b.left - prev.left) > 1E-3 || std::abs(b.top - prev.top) > 1E-3);
+      if(prev.isValid() && (moved || std::abs(b.width() - prev.width()) > 1E-3 || std::abs(b.height() - prev.height()) > 1E-3)) {
+        dirtyRoots.assign(1, top);
+        break;
+      }
+    }
+    if(dirtyRoots.size() == 1 && dirtyRoots[0] == top) {
+      if(top->widgetClass() == Widget::WindowClass)
+        layoutWindow(static_cast<Window*>(top), static_cast<Window*>(top)->winBounds());
+      else
+        layoutAbsPosWidget(top);
+    }
+    Rect laybounds;
+    if(debugDirty) {
+      for(Widget* root : dirtyRoots)
+        laybounds.rectUnion(root->node->bounds());
+    }
+    return laybounds;
+  };
+
   size_t layoutidx = windows.size();
   while(layoutidx > 0) {
     Window* win = windows[--layoutidx];
     Rect winbounds = win->winBounds();
-    Widget* layoutDirtyRoot = findLayoutDirtyRoot(win);
-    if(layoutDirtyRoot == win || debugLayout)
-      layoutWindow(win, winbounds);
-    else if(layoutDirtyRoot)
-      // bounds() could include newly shown widgets that have never been laid out, so use renderedBounds
-      layoutWidget(layoutDirtyRoot, layoutDirtyRoot->parent()->node->m_renderedBounds);  // bounds());
+    Rect laydirty = layoutDirty(win, debugLayout);
 
     if(winbounds.width() == 0 || winbounds.height() == 0) {
       // should we use lay_get_rect(root) (in layoutDoc()) instead of transformedBounds() here?
@@ -1774,25 +3160,18 @@ Rect SvgGui::layoutAndDraw(Painter* painter)
       win->setWinBounds(Rect::centerwh(winbounds.center(), newbounds.width(), newbounds.height()));
     }
 
-    Rect windirty = SvgPainter::calcDirtyRect(win->node);
-    Rect laydirty = layoutDirtyRoot && debugDirty ? layoutDirtyRoot->node->bounds() : Rect();
     Point origin = win->winBounds().origin();
+    std::vector<Rect>& windirty = layered && !isOverlay(layoutidx, -1, win) ? underlayDirty : dirty;
+    addDirtyRects(windirty, win->node, origin, maxDirtyRects, layered);
     if(win->node->m_dirty > SvgNode::CHILD_DIRTY && win->m_shadow) {
-      windirty.rectUnion(win->m_shadow->bounds(win->node->bounds()));
-      windirty.rectUnion(win->m_shadow->bounds(win->node->m_renderedBounds));
+      addDirtyRect(windirty, win->m_shadow->bounds(win->node->bounds()).translate(origin), maxDirtyRects);
+      addDirtyRect(windirty, win->m_shadow->bounds(win->node->m_renderedBounds).translate(origin), maxDirtyRects);
     }
 
-    for(AbsPosWidget* w : win->absPosNodes) {
+    for(size_t jj = 0; jj < win->absPosNodes.size(); ++jj) {
+      AbsPosWidget* w = win->absPosNodes[jj];
       SvgNode* parentnode = w->node->parent();
-      if(parentnode->bounds() != parentnode->m_renderedBounds)
-        layoutDirtyRoot = w;
-      else
-        layoutDirtyRoot = findLayoutDirtyRoot(w);
-
-      if(layoutDirtyRoot == w || debugLayout)
-        layoutAbsPosWidget(w);
-      else if(layoutDirtyRoot)
-        layoutWidget(layoutDirtyRoot, layoutDirtyRoot->parent()->node->m_renderedBounds);  // bounds());
+      laydirty.rectUnion(layoutDirty(w, debugLayout || parentnode->bounds() != parentnode->m_renderedBounds));
 
       // adjust position to keep on screen (not necessarily inside parent bounds)
       Rect b = w->node->bounds().translate(origin);
@@ -1803,16 +3182,15 @@ Rect SvgGui::layoutAndDraw(Painter* painter)
       if(dx != 0 || dy != 0)
         w->setLayoutTransform(Transform2D::translating(dx, dy) * w->layoutTransform());
 
-      windirty.rectUnion(SvgPainter::calcDirtyRect(w->node));
-      laydirty.rectUnion(layoutDirtyRoot && debugDirty ? layoutDirtyRoot->node->bounds() : Rect());
+      std::vector<Rect>& absdirty = layered && !isOverlay(layoutidx, int(jj), w) ? underlayDirty : dirty;
+      addDirtyRects(absdirty, w->node, origin, maxDirtyRects, layered);
 
       if(w->node->m_dirty > SvgNode::CHILD_DIRTY && w->m_shadow) {
-        windirty.rectUnion(w->m_shadow->bounds(w->node->bounds()));
-        windirty.rectUnion(w->m_shadow->bounds(w->node->m_renderedBounds));
+        addDirtyRect(absdirty, w->m_shadow->bounds(w->node->bounds()).translate(origin), maxDirtyRects);
+        addDirtyRect(absdirty, w->m_shadow->bounds(w->node->m_renderedBounds).translate(origin), maxDirtyRects);
       }
     }
 
-    dirty.rectUnion(windirty.translate(origin));
     layoutDirtyRect.rectUnion(laydirty.translate(origin));
     if(win->winBounds().contains(screenRect))
       break;
@@ -1838,74 +3216,411 @@ Rect SvgGui::layoutAndDraw(Painter* painter)
     currInputWidget = nextInputWidget;
   }
 
-  if(!dirty.isValid() && !debugDirty)
+  // layout for this frame is complete
+  releaseLayoutPool();
+  // keep registered widgets in windows that weren't laid out (or not in a window yet)
+  auto laidout = [&](Widget* w){
+    Window* win = w->window();
+    if(!win || std::find(windows.begin() + layoutidx, windows.end(), win) == windows.end())
+      return false;
+    w->m_layoutDirtyRegistered = false;
+    return true;
+  };
+  layoutDirtyWidgets.erase(std::remove_if(layoutDirtyWidgets.begin(), layoutDirtyWidgets.end(), laidout),
+      layoutDirtyWidgets.end());
+
+  // full bounds of node including shadow, for changes to underlay
+  auto nodeDirtyRect = [](const AbsPosWidget* w){
+    Rect r = Rect(w->node->bounds()).rectUnion(w->node->m_renderedBounds);
+    if(w->m_shadow) {
+      r.rectUnion(w->m_shadow->bounds(w->node->bounds()));
+      r.rectUnion(w->m_shadow->bounds(w->node->m_renderedBounds));
+    }
+    return r;
+  };
+
+  bool fullUnderlay = false;
+  if(layered) {
+    int devw = int(painter->deviceRect.width()), devh = int(painter->deviceRect.height());
+    // when a layer is shown, content beneath it is already on screen (drawn by previous frame), so copy it
+    //  instead of drawing whole underlay; underlayNodes is set to nodes drawn in previous frame, so those now
+    //  above the layer are removed from underlay below (layer must be in top window so disabled window
+    //  overlays in screen image match underlay)
+    bool snapshot = !underlay && painter->targetImage && painter->targetImage->width == devw
+        && painter->targetImage->height == devh && !fullRedraw && drawFrameCount > 1
+        && layerWin + 1 == windows.size() && paintScale == underlayScale;
+    if(!underlay || underlay->width != devw || underlay->height != devh) {
+      underlay.reset(new Image(devw, devh));
+      underlayPainter.reset(new Painter(Painter::PAINT_SW, underlay.get()));
+      underlayPainter->deviceRect = Rect::wh(devw, devh);
+      fullUnderlay = !snapshot;
+    }
+    if(snapshot) {
+      memcpy(underlay->bytes(), painter->targetImage->bytes(), size_t(devw)*devh*4);
+      underlayNodes.clear();
+      underlayDims = 0;
+      for(size_t ii = layoutidx; ii < windows.size(); ++ii) {
+        // m_renderedBounds is only valid for nodes that were drawn
+        if(windows[ii]->node->m_renderedBounds.isValid())
+          underlayNodes.push_back(windows[ii]->node);
+        for(AbsPosWidget* w : windows[ii]->absPosNodes) {
+          if(w->node->m_renderedBounds.isValid())
+            underlayNodes.push_back(w->node);
+        }
+        if(ii + 1 < windows.size())
+          ++underlayDims;
+      }
+    }
+    // nodes in underlay - a node moving between underlay and overlay (e.g. because layer is shown above it)
+    //  must be added to or removed from underlay
+    std::vector<SvgNode*> nodes;
+    size_t ndims = 0;
+    for(size_t ii = layoutidx; ii < windows.size(); ++ii) {
+      Window* win = windows[ii];
+      Point origin = win->winBounds().origin();
+      auto addNode = [&](const AbsPosWidget* w, int jj){
+        bool found = std::find(underlayNodes.begin(), underlayNodes.end(), w->node) != underlayNodes.end();
+        if(!isOverlay(ii, jj, w))
+          nodes.push_back(w->node);
+        if(found == isOverlay(ii, jj, w))
+          addDirtyRect(underlayDirty, nodeDirtyRect(w).translate(origin), maxDirtyRects);
+      };
+      addNode(win, -1);
+      for(size_t jj = 0; jj < win->absPosNodes.size(); ++jj)
+        addNode(win->absPosNodes[jj], int(jj));
+      if(ii + 1 < windows.size() && ii < layerWin)
+        ++ndims;
+    }
+    // windows shown or closed above layer are overlays; changes to windows in underlay are handled via
+    //  underlayNodes and closedWindowBounds, but for simplicity, redraw underlay if disabled window overlays
+    //  in it change
+    if(ndims != underlayDims || paintScale != underlayScale)
+      fullUnderlay = true;
+    underlayNodes.swap(nodes);
+    underlayDims = ndims;
+    underlayScale = paintScale;
+    if(fullUnderlay)
+      underlayDirty.assign(1, Rect(painter->deviceRect).scale(1/paintScale));
+    // content beneath underlay changes must be copied to screen
+    for(const Rect& r : underlayDirty)
+      addDirtyRect(dirty, r, maxDirtyRects);
+  }
+
+  // if, e.g., fill changes via CSS, node can be PIXELS_DIRTY + needsRestyle (but with valid bounds), and
+  //  may not be restyled until actually rendered (alternative: manually restyle everything before rendering)
+  //ASSERT(win->node->m_dirty == SvgNode::NOT_DIRTY && "Window was dirtied during rendering!");
+  // don't clear dirty for windows that weren't laid out since that prevents relayout when they become visible;
+  //  windows that were laid out are cleared even if some of their dirty rects weren't drawn, since those are
+  //  hidden by windows above and will be drawn when those close or move (otherwise needsFrame() would never
+  //  return false)
+  auto clearWindowsDirty = [&](){
+    for(size_t ii = layoutidx; ii < windows.size(); ++ii) {
+      Window* win = windows[ii];
+      if(win->node->m_dirty != SvgNode::NOT_DIRTY && hitTestBoundsDirty(win->node)) {
+        win->hitGrid.reset();
+        win->boundsDirtyRun = win->boundsDirtyFrame + 1 == drawFrameCount ? win->boundsDirtyRun + 1 : 1;
+        win->boundsDirtyFrame = drawFrameCount;
+      }
+      SvgPainter::clearDirty(win->node);
+    }
+  };
+
+  if(dirtyRects)
+    dirtyRects->clear();
+  if(dirty.empty() && !debugDirty) {
+    clearWindowsDirty();
     return Rect();
+  }
 
-  // find bottommost window covering dirty rect
-  auto findDirtyCover = [this](Rect r, size_t min){
-    size_t ii = windows.size() - 1;
+  // find bottommost window covering dirty rect, considering only windows up to max and, if layered, only
+  //  content in underlay
+  auto findDirtyCover = [&](Rect r, size_t min, size_t max){
+    size_t ii = max;
     for(; ii > min; --ii) {
-      if(windows[ii]->winBounds().contains(r))
+      if(windows[ii]->winBounds().contains(r) && !isOverlay(ii, -1, windows[ii]))
         return ii;
-      for(Widget* w : windows[ii]->absPosNodes) {
-        if(w->node->bounds().contains(r))
+      for(size_t jj = 0; jj < windows[ii]->absPosNodes.size(); ++jj) {
+        AbsPosWidget* w = windows[ii]->absPosNodes[jj];
+        if(w->node->bounds().contains(r) && !isOverlay(ii, int(jj), w))
           return ii;  // ... this is why we can't use break!
       }
     }
     return ii;  // = 0
   };
-  size_t ii = debugDirty || fullRedraw ? 0 : findDirtyCover(dirty, layoutidx);  // layoutidx is bottommost window updated
 
-  // ... then draw that window and those above it
+  // draw windows starting from ii; part = 0 to draw everything, 1 for underlay content only, 2 for overlay
+  auto drawWindows = [&](Painter* p, const Rect& cliprect, size_t ii, int part){
+    for(; ii < windows.size(); ++ii) {
+      Window* win = windows[ii];
+      //if(!win->winBounds().intersects(cliprect)) continue;
+      Point origin = win->winBounds().origin();
+      Rect winclip = Rect(cliprect).translate(-origin);
+
+      p->translate(origin);
+      //if(win->hasShadow() && win->shadowBounds(win->winBounds().toSize()).intersects(winclip))
+      //  drawShadow(painter, win);
+      if(part == 0 || (part == 2) == isOverlay(ii, -1, win)) {
+        if(occlusionCulling)
+          findOccludedNodes(win->node, winclip);
+        SvgPainter(p).drawNode(win->node, winclip);
+        occludedNodes.clear();
+      }
+      for(size_t jj = 0; jj < win->absPosNodes.size(); ++jj) {
+        AbsPosWidget* widget = win->absPosNodes[jj];
+        //if(widget->hasShadow() && widget->shadowBounds(widget->node->bounds()).intersects(winclip))
+        //  drawShadow(painter, widget);
+        if(part == 0 || (part == 2) == isOverlay(ii, int(jj), widget))
+          SvgPainter(p).drawNode(widget->node, winclip);
+      }
+
+      // unfortunate hack to draw overlay for disabled window - previously, we set class=disabled on window to
+      //  show a box-anchor=fill node, but that forces restyle and layout of whole window (and sets icons to
+      //  disabled).  A possible alternative is to use an abs pos node for the overlay
+      // <rect id="disabled-overlay" display="none" position="absolute" left="0" right="0" top="0" bottom="0" width="20" height="20"/>
+      if(ii + 1 < windows.size() && (part == 0 || (part == 2) == (layered && ii >= layerWin)))
+        p->fillRect(win->winBounds().toSize(), Color(0, 0, 0, 128));
+
+      p->translate(-origin);
+    }
+  };
+
+  if(!underlayDirty.empty()) {
+    underlayPainter->beginFrame();
+    underlayPainter->scale(paintScale);
+    underlayPainter->setsRGBAdjAlpha(true);
+    // layered implies layerWin > 0 if window itself is layer
+    size_t maxcover = layerAbs < 0 ? layerWin - 1 : layerWin;
+    for(const Rect& r : underlayDirty) {
+      Rect cliprect = Rect(r).pad(1).scale(paintScale).round().rectIntersect(underlayPainter->deviceRect);
+      if(!cliprect.isValid())
+        continue;
+      cliprect.scale(1/paintScale);
+      underlayPainter->setClipRect(cliprect);
+      size_t ii = findDirtyCover(r, layoutidx, std::max(maxcover, layoutidx));
+      drawWindows(underlayPainter.get(), Rect(cliprect).pad(1), ii, 1);
+    }
+    underlayPainter->endFrame();
+    painter->invalidateImage(underlay->painterHandle);
+  }
+
   painter->beginFrame();
   painter->scale(paintScale);  // beginFrame resets Painter state
   painter->setsRGBAdjAlpha(true);
 
   // Painter aligns clip rect w/ pixel boundaries, but we want to do it here to get basis for dirty rect
-  Rect dirtypx = Rect(dirty).pad(1).scale(paintScale).round().rectIntersect(painter->deviceRect);
-  Rect cliprect = Rect(debugDirty || fullRedraw ? painter->deviceRect : dirtypx).scale(1/paintScale);
-  if(!painter->usesGPU())
-    painter->setClipRect(cliprect);  // not needed for GL renderer since we use glScissor
-  cliprect.pad(1);  // I think this assumes paintScale >= 0.5 (not unreasonable)
-
-  for(; ii < windows.size(); ++ii) {
-    Window* win = windows[ii];
-    //if(!win->winBounds().intersects(cliprect)) continue;
-    Point origin = win->winBounds().origin();
-    Rect winclip = Rect(cliprect).translate(-origin);
-
-    painter->translate(origin);
-    //if(win->hasShadow() && win->shadowBounds(win->winBounds().toSize()).intersects(winclip))
-    //  drawShadow(painter, win);
-    SvgPainter(painter).drawNode(win->node, winclip);
-    for(AbsPosWidget* widget : win->absPosNodes) {
-      //if(widget->hasShadow() && widget->shadowBounds(widget->node->bounds()).intersects(winclip))
-      //  drawShadow(painter, widget);
-      SvgPainter(painter).drawNode(widget->node, winclip);
-    }
-
-    // unfortunate hack to draw overlay for disabled window - previously, we set class=disabled on window to
-    //  show a box-anchor=fill node, but that forces restyle and layout of whole window (and sets icons to
-    //  disabled).  A possible alternative is to use an abs pos node for the overlay
-    // <rect id="disabled-overlay" display="none" position="absolute" left="0" right="0" top="0" bottom="0" width="20" height="20"/>
-    if(ii + 1 < windows.size())  //if(!win->m_enabled) ... we no longer set windows as disabled
-      painter->fillRect(win->winBounds().toSize(), Color(0, 0, 0, 128));
-
-    painter->translate(-origin);
-    // if, e.g., fill changes via CSS, node can be PIXELS_DIRTY + needsRestyle (but with valid bounds), and
-    //  may not be restyled until actually rendered (alternative: manually restyle everything before rendering)
-    //ASSERT(win->node->m_dirty == SvgNode::NOT_DIRTY && "Window was dirtied during rendering!");
-    // don't clear dirty for unrendered windows since that prevents relayout when they become visible
-    SvgPainter::clearDirty(win->node);
+  Rect dirtypx;
+  std::vector<Rect> localRects;
+  std::vector<Rect>& rectspx = dirtyRects ? *dirtyRects : localRects;
+  size_t ndirty = 0;
+  for(const Rect& r : dirty) {
+    Rect rectpx = Rect(r).pad(1).scale(paintScale).round().rectIntersect(painter->deviceRect);
+    if(rectpx.isValid()) {
+      dirtypx.rectUnion(rectpx);
+      rectspx.push_back(rectpx);
+      dirty[ndirty++] = r;  // keep dirty and rectspx in sync
+    }
+  }
+  dirty.resize(ndirty);
+
+  bool full = debugDirty || fullRedraw;
+  size_t npasses = full ? 1 : rectspx.size();
+  // draw dirty rect jj (clipped to clippx) with p
+  auto drawPass = [&](Painter* p, size_t jj, const Rect& clippx) {
+    Rect cliprect = Rect(clippx).scale(1/paintScale);
+    // not needed for GL renderer w/ single dirty rect since we use glScissor
+    if(!p->usesGPU() || rectspx.size() > 1)
+      p->setClipRect(cliprect);
+    if(layered) {
+      // copy underlay, then draw layers and everything above them
+      p->drawImage(*underlay, cliprect, clippx);
+      drawWindows(p, Rect(cliprect).pad(1), layerWin, 2);
+      return;
+    }
+    // ... then draw bottommost window covering dirty rect and those above it
+    size_t ii = full ? 0 : findDirtyCover(dirty[jj], layoutidx, windows.size() - 1);  // layoutidx is bottommost window updated
+    cliprect.pad(1);  // I think this assumes paintScale >= 0.5 (not unreasonable)
+    drawWindows(p, cliprect, ii, 0);
+  };
+
+  // tile-parallel software rendering: dirty region is split into horizontal bands, each recorded (serially, since
+  //  drawing accesses widget tree) by its own Painter w/ same target image and clipped to band, then bands are
+  //  rasterized in parallel; painter itself draws nothing in this case
+  Rect bandspx = full ? Rect(painter->deviceRect) : dirtypx;
+#ifdef NO_PAINTER_SW
+  size_t nbands = 1;
+#else
+  size_t nbands = std::min(size_t(std::max(renderThreads, 1)), size_t(std::max(bandspx.height(), real(0))/64));
+#endif
+  if(nbands > 1 && !layered && !painter->usesGPU() && painter->targetImage) {
+    if(tilePainters.size() != nbands || tilePainters[0]->targetImage != painter->targetImage)
+      tilePainters.clear();
+    for(size_t kk = tilePainters.size(); kk < nbands; ++kk)
+      tilePainters.emplace_back(new Painter(Painter::PAINT_SW, painter->targetImage));
+    for(size_t kk = 0; kk < nbands; ++kk) {
+      Painter* tp = tilePainters[kk].get();
+      Rect band = Rect::ltrb(bandspx.left, std::round(bandspx.top + kk*bandspx.height()/nbands),
+          bandspx.right, std::round(bandspx.top + (kk+1)*bandspx.height()/nbands));
+      tp->deviceRect = painter->deviceRect;
+      tp->beginFrame();
+      tp->scale(paintScale);
+      tp->setsRGBAdjAlpha(true);
+      for(size_t jj = 0; jj < npasses; ++jj) {
+        Rect clippx = Rect(full ? painter->deviceRect : rectspx[jj]).rectIntersect(band);
+        if(clippx.isValid())
+          drawPass(tp, jj, clippx);
+      }
+    }
+    if(!tileWorkers || tileWorkers->size() + 1 < nbands)
+      tileWorkers.reset(new TileWorkers(nbands - 1));
+    std::vector<Painter*> bands;
+    for(size_t kk = 0; kk < nbands; ++kk)
+      bands.push_back(tilePainters[kk].get());
+    // if recording, bands are rasterized by DeferredFrame::rasterize(), otherwise before caller calls endFrame()
+    if(recordingFrame) {
+      recordingFrame->bands.swap(bands);
+      recordingFrame->workers = tileWorkers.get();
+    }
+    else
+      tileWorkers->endFrame(bands);
+  }
+  else {
+    for(size_t jj = 0; jj < npasses; ++jj)
+      drawPass(painter, jj, full ? painter->deviceRect : rectspx[jj]);
   }
+  clearWindowsDirty();
+
   if(debugDirty) {
     painter->fillRect(layoutDirtyRect, Color(0, 255, 0, 64));
-    painter->fillRect(dirty, Color(255, 0, 0, 64));
+    for(const Rect& r : dirty)
+      painter->fillRect(r, Color(255, 0, 0, 64));
     return painter->deviceRect;
   }
   return dirtypx;
 }
 
+// record frame into df for deferred rasterization instead of leaving it to caller to call painter->endFrame()
+//  after layoutAndDraw()
+bool SvgGui::recordFrame(Painter* painter, DeferredFrame* df)
+{
+  df->clear();
+  df->painter = painter;
+  recordingFrame = df;
+  df->dirty = layoutAndDraw(painter, &df->dirtyRects);
+  recordingFrame = NULL;
+  df->images.swap(frameImages);
+  df->frame = drawFrameCount;
+  return !df->empty();
+}
+
+void DeferredFrame::rasterize()
+{
+  if(painter && !empty()) {
+    if(workers && !bands.empty())
+      workers->endFrame(bands);
+    painter->endFrame();
+  }
+  clear();
+}
+
+void DeferredFrame::clear()
+{
+  dirty = Rect();
+  dirtyRects.clear();
+  images.clear();
+  bands.clear();
+  workers = NULL;
+}
+
+TileWorkers::TileWorkers(size_t nthreads)
+{
+  for(size_t ii = 0; ii < nthreads; ++ii) {
+    start.emplace_back(new Semaphore);
+    threads.emplace_back(&TileWorkers::run, this, ii);
+  }
+}
+
+TileWorkers::~TileWorkers()
+{
+  quit = true;
+  for(auto& sem : start)
+    sem->post();
+  for(std::thread& thread : threads)
+    thread.join();
+}
+
+// worker idx rasterizes band idx + 1
+void TileWorkers::run(size_t idx)
+{
+  while(1) {
+    start[idx]->wait();
+    if(quit)
+      break;
+    (*bands)[idx + 1]->endFrame();
+    done.post();
+  }
+}
+
+void TileWorkers::endFrame(const std::vector<Painter*>& painters)
+{
+  size_t nworkers = std::min(painters.size() - 1, threads.size());
+  bands = &painters;
+  for(size_t ii = 0; ii < nworkers; ++ii)
+    start[ii]->post();
+  // any bands beyond number of workers are rasterized here
+  for(size_t ii = nworkers + 1; ii < painters.size(); ++ii)
+    painters[ii]->endFrame();
+  painters[0]->endFrame();
+  for(size_t ii = 0; ii < nworkers; ++ii)
+    done.wait();
+  bands = NULL;
+}
+
+RenderThread::RenderThread(const std::function<void(DeferredFrame*)>& fn) : renderFn(fn)
+{
+  thread = std::thread(&RenderThread::run, this);
+}
+
+// RenderThread must be destroyed before painter and SvgGui
+RenderThread::~RenderThread()
+{
+  wait();
+  quit = true;
+  frameReady.post();
+  thread.join();
+}
+
+void RenderThread::run()
+{
+  while(1) {
+    frameReady.wait();
+    if(quit)
+      break;
+    if(renderFn)
+      renderFn(&frame);
+    frame.rasterize();  // no-op if renderFn already called rasterize()
+    frameDone.post();
+  }
+}
+
+// waits for frame in flight (back-pressure), then records next frame on calling thread and hands it off
+bool RenderThread::submit(SvgGui* gui, Painter* painter)
+{
+  wait();
+  if(!gui->recordFrame(painter, &frame))
+    return false;
+  inFlight = true;
+  frameReady.post();
+  return true;
+}
+
+void RenderThread::wait()
+{
+  if(inFlight) {
+    frameDone.wait();
+    inFlight = false;
+  }
+}
+
 // should move this to SvgParser
 const SvgDocument* SvgGui::useFile(const char* filename, std::unique_ptr<SvgDocument> pdoc)
 {
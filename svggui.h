@@ -10,17 +10,112 @@
 // https://github.com/randrew/layout - based on https://bitbucket.org/duangle/oui-blendish
 //extern "C" {
 #define LAY_FLOAT 1
+// define LAY_SOA to use the structure-of-arrays layout backend (SSE2/NEON unless LAY_NO_SIMD is defined)
 #define LAY_ASSERT ASSERT
 #include "layout.h"
 
 class Window;
 class SvgGui;
 class Painter;
+class Widget;
+
+// lay_items for a Window or abs pos widget kept across frames - see SvgGui::persistentLayout
+struct LayoutTree
+{
+  LayoutTree() { lay_init_context(&ctx); }
+  ~LayoutTree() { lay_destroy_context(&ctx); }
+  LayoutTree(const LayoutTree&) = delete;
+  bool contains(const Widget* w) const;
+  void clear();
+
+  lay_context ctx;
+  std::vector<Widget*> widgets;  // Widget for each lay_id, used to validate Widget::m_layoutId
+  std::vector<lay_scalar> prevRects;  // rects from previous run so applyLayout can skip unchanged subtrees
+  std::vector<bool> reused;  // items reused as is (i.e. clean subtree) for current run
+  lay_id rebuildCount = 0;  // number of items after last full rebuild
+};
+
+// uniform grid of widgets in a Window (excluding abs pos widgets) for SvgGui::widgetAt(); entries are in paint
+//  order and each cell lists entries whose bounds intersect it
+struct HitTestGrid
+{
+  struct Entry {
+    Widget* widget;
+    Rect bounds;
+    bool occluded;  // a later non-widget node (not indexed) may overlap widget, so full search is needed
+  };
+  std::vector<Entry> entries;
+  std::vector< std::vector<unsigned int> > cells;
+  Rect bbox;
+  real cellSize = 64;
+  int nx = 0, ny = 0;
+};
+
+// bump allocator for layout.h scratch memory (via LAY_REALLOC/LAY_FREE) - blocks are released in bulk by
+//  reset() at the end of each frame; buffer grows to fit the largest frame seen so far
+class LayoutArena
+{
+public:
+  LayoutArena() {}
+  ~LayoutArena();
+  LayoutArena(const LayoutArena&) = delete;
+  void* realloc(void* p, size_t size);  // p must be NULL or owned by arena
+  bool owns(const void* p) const { return p >= buf && p < buf + capacity; }
+  void reset();
+
+  struct Stats {
+    int heapAllocs = 0;  // layout.h (re)allocations that went to the heap
+    int arenaAllocs = 0;
+    size_t arenaBytes = 0;
+  };
+  Stats stats;  // current frame
+  Stats prevStats;  // last completed frame
+
+private:
+  static constexpr size_t ALIGN = 16;  // block header size and alignment
+  char* buf = NULL;
+  size_t capacity = 0;
+  size_t used = 0;
+  size_t lastBlock = 0;  // offset of last block, which can be resized in place
+  size_t overflow = 0;  // bytes requested in excess of capacity this frame
+};
+
+// interned names of attributes used by ugui, so attribute changes can be handled by comparing ids instead of
+//  strings; attrAtom() returns ATOM_NONE for any other name
+enum AttrAtom { ATOM_NONE = 0, ATOM_LEFT, ATOM_TOP, ATOM_RIGHT, ATOM_BOTTOM, ATOM_BOX_ANCHOR, ATOM_FLEX_BREAK,
+    ATOM_LAYOUT, ATOM_FLEX_DIRECTION, ATOM_FLEX_WRAP, ATOM_JUSTIFY_CONTENT, ATOM_BOX_SHADOW, ATOM_BORDER_RADIUS,
+    ATOM_MARGIN, ATOM_MARGIN_LEFT, ATOM_MARGIN_TOP, ATOM_MARGIN_RIGHT, ATOM_MARGIN_BOTTOM, ATOM_POSITION,
+    ATOM_RENDER_CACHE, ATOM_COUNT };
+int attrAtom(const char* name);
+unsigned int attrAtomLayoutGroups(int atom);  // Widget::LayoutVarGroup flags; nonzero if attr affects layout
+
+// wrapper for Widget::eventFilter which bumps a generation counter whenever a filter is set or cleared, so that
+//  Widget::hasFilterChain() can cache whether any filter needs to be called for events sent to widget
+class EventFilter
+{
+public:
+  typedef std::function<bool(SvgGui*, Widget*, SDL_Event*)> Fn;
+  EventFilter() {}
+  EventFilter(const EventFilter&) = delete;
+  EventFilter& operator=(const EventFilter&) = delete;
+  ~EventFilter() { if(fn) ++generation; }
+  EventFilter& operator=(const Fn& f) { if(bool(fn) || bool(f)) ++generation;  fn = f;  return *this; }
+  explicit operator bool() const { return bool(fn); }
+  bool operator()(SvgGui* gui, Widget* widget, SDL_Event* event) const { return fn(gui, widget, event); }
+
+  // incremented when a filter is set or cleared or a widget is added or removed (starts at 1 so that
+  //  Widget::filterChainGen = 0 is never current)
+  static unsigned int generation;
+
+private:
+  Fn fn;
+};
 
 class Widget : public SvgNodeExtension
 {
 public:
   Widget(SvgNode* n);
+  ~Widget() override;
   Widget* clone() const override { ASSERT(0 && "Widgets cannot be cloned"); return NULL; }
   Widget* createExt(SvgNode* n) const override { ASSERT(0 && "Widgets must be created explicitly");  return new Widget(n); }
 
@@ -39,7 +134,13 @@ public:
   void setVisible(bool visible = true);
   bool isDisplayed() const { return isVisible() && (!parent() || parent()->isDisplayed()); }
   void setLayoutIsolate(bool isolate) { layoutIsolate = isolate; }
+  // keep rendered pixels of widget to draw instead of its contents while unchanged; also render-cache="bitmap"
+  void setRenderCache(bool cache);
+  bool usesRenderCache() const;
   virtual void updateLayoutVars();
+  void invalidateLayoutVars(unsigned int groups);
+  void setLayoutDirty();
+  void bumpLayoutGen();
 
   virtual void setText(const char* s);  // consider removing since we have TextBox class now
   Widget* selectFirst(const char* selector) const;
@@ -53,6 +154,7 @@ public:
   enum WidgetClass_t { WidgetClass, AbsPosWidgetClass, WindowClass };
   virtual WidgetClass_t widgetClass() const { return WidgetClass; }
   bool isDescendantOf(Widget* parent) const;
+  bool isAbsPosNode() const;
   bool isEmpty() const { return !node->asContainerNode() || node->asContainerNode()->children().empty(); }
 
   // this might be overkill - could just use void* for user data and require user handle deletion
@@ -67,12 +169,24 @@ public:
   void serializeAttr(SvgWriter* writer) override;
   void onAttrChange(const char* name) override;
 
-  void addHandler(const std::function<bool(SvgGui*, SDL_Event*)>& fn) { sdlHandlers.emplace_back(fn); }
+  // classes of events for addHandler() - handler is only called for events in its mask, and sdlEvent() returns
+  //  immediately if no handler is interested, so bubbling skips the widget
+  enum EventMask : unsigned int { MOTION_EVENTS = 1, PRESS_EVENTS = 2, MULTITOUCH_EVENTS = 4, HOVER_EVENTS = 8,
+      FOCUS_EVENTS = 16, KEY_EVENTS = 32, WHEEL_EVENTS = 64, STATE_EVENTS = 128, OTHER_EVENTS = 0x80000000,
+      ALL_EVENTS = ~0u };
+  static unsigned int eventMask(Uint32 type);
+  void addHandler(const std::function<bool(SvgGui*, SDL_Event*)>& fn, unsigned int mask = ALL_EVENTS);
   bool sdlEvent(SvgGui* gui, SDL_Event* event);
   bool sdlUserEvent(SvgGui* gui, Uint32 type, Sint32 code = 0, void* data1 = NULL, void* data2 = NULL);
 
   std::vector< std::function<bool(SvgGui*, SDL_Event*)> > sdlHandlers;
-  std::function<bool(SvgGui*, Widget*, SDL_Event*)> eventFilter;
+  std::vector<unsigned int> sdlHandlerMasks;  // mask for each handler in sdlHandlers
+  unsigned int sdlHandlersMask = 0;  // union of sdlHandlerMasks
+  EventFilter eventFilter;
+  // true if widget or an ancestor (up to and including abs pos widget) has an eventFilter
+  bool hasFilterChain();
+  unsigned int filterChainGen = 0;
+  bool filterChain = false;
 
   //Rect layoutBounds;
   void setLayoutBounds(const Rect& dest);
@@ -90,7 +204,35 @@ public:
   unsigned int layContain = 0;
   unsigned int layBehave = 0;
   bool layoutVarsValid = false;
+  // groups of layout attributes that have changed since last updateLayoutVars()
+  enum LayoutVarGroup { LAYV_MARGINS = 1, LAYV_CONTAIN = 2, LAYV_BEHAVE = 4, LAYV_SHADOW = 8,
+      LAYV_RADIUS = 16, LAYV_OFFSETS = 32, LAYV_ALL = 63 };
+  unsigned int layoutVarsStale = LAYV_ALL;
   bool layoutIsolate = false;
+  mutable signed char m_absPosNode = -1;  // cached position == absolute; -1 if unknown
+  bool m_layoutDirtyRegistered = false;  // see SvgGui::trackLayoutDirty
+  // incremented for widget and ancestors by changes (outside of layout of an ancestor) that may affect layout
+  unsigned int layoutGen = 0;
+
+  // result of SvgGui::layoutWidget() for this widget, reused if constraint bbox and layoutGen are unchanged
+  struct LayoutCache {
+    LayoutCache() { lay_init_context(&ctx); }
+    ~LayoutCache() { lay_destroy_context(&ctx); }
+    LayoutCache(const LayoutCache&) = delete;
+    lay_context ctx;
+    Rect bbox;
+    unsigned int gen = 0;
+  };
+  std::unique_ptr<LayoutCache> m_layoutCache;
+
+  // rendered pixels of widget at current paintScale, drawn instead of contents if node is not dirty
+  struct RenderCache {
+    std::shared_ptr<Image> image;  // shared w/ DeferredFrame of frames using it
+    Rect devBounds;  // device pixel rect image is drawn to
+    unsigned int frame = 0;  // frame in which image was rendered
+  };
+  mutable std::unique_ptr<RenderCache> m_renderCache;
+  mutable signed char m_renderCacheMode = -1;  // render-cache == bitmap; -1 if unknown
 
   Transform2D m_layoutTransform;
   bool m_enabled = true;
@@ -116,8 +258,16 @@ public:
   SvgLength offsetBottom;
 
   virtual Point calcOffset(const Rect& parentbbox) const;  // allow overriding for more complex positioning
+  void setOffsets(const SvgLength& left, const SvgLength& top,
+      const SvgLength& right = SvgLength(NaN), const SvgLength& bottom = SvgLength(NaN));
   void updateLayoutVars() override;
   WidgetClass_t widgetClass() const override { return AbsPosWidgetClass; }
+  // draw over offscreen image of content beneath, so showing, hiding, or moving widget doesn't redraw it
+  void setCompositeLayer(bool layer) { compositeLayer = layer; }
+
+  bool compositeLayer = false;
+
+  std::unique_ptr<LayoutTree> layoutTree;
 };
 
 class Window : public AbsPosWidget
@@ -151,6 +301,9 @@ public:
   std::string winTitle;
   std::string windowXmlClass;
   std::vector<AbsPosWidget*> absPosNodes;
+  std::unique_ptr<HitTestGrid> hitGrid;  // built on demand, reset by layoutAndDraw if any bounds change
+  unsigned int boundsDirtyFrame = 0;  // frame in which bounds last changed
+  int boundsDirtyRun = 0;  // number of consecutive frames, ending at boundsDirtyFrame, in which bounds changed
   SDL_Window* sdlWindow = NULL;
 };
 
@@ -169,6 +322,75 @@ struct Timer
   friend bool operator<(const Timer& a, const Timer& b) { return a.nextTick < b.nextTick; }
 };
 
+// persistent threads which rasterize bands recorded by tile painters in parallel (see SvgGui::renderThreads)
+class TileWorkers
+{
+public:
+  TileWorkers(size_t nthreads);
+  ~TileWorkers();
+  size_t size() const { return threads.size(); }
+  // calls endFrame() for each painter; first one on calling thread, others on workers (at most size())
+  void endFrame(const std::vector<Painter*>& painters);
+
+private:
+  void run(size_t idx);
+
+  std::vector<std::thread> threads;
+  std::vector< std::unique_ptr<Semaphore> > start;
+  Semaphore done;
+  const std::vector<Painter*>* bands = NULL;
+  bool quit = false;
+};
+
+// deferred rasterization of a frame drawn by SvgGui::recordFrame() - Painter accumulates drawing commands
+//  between beginFrame() and endFrame() (paths are transformed and flattened as they are added) and only
+//  rasterizes them in endFrame(), so widgets can be modified as soon as frame is recorded and rasterize() can
+//  be called later (from another thread for software painter).  This is not a retained display list: commands
+//  aren't kept after rasterization, so every dirty region is drawn from the widget tree each frame.  Frame must
+//  be rasterized before the next one is recorded since painter, tile painters, and offscreen images (render
+//  caches, underlay) are reused
+struct DeferredFrame
+{
+  Painter* painter = NULL;
+  Rect dirty;  // union of dirtyRects; invalid if nothing to draw
+  std::vector<Rect> dirtyRects;  // device pixels
+  std::vector< std::shared_ptr<Image> > images;  // keeps images drawn in frame alive, e.g., if widget is deleted
+  std::vector<Painter*> bands;  // tile painters rasterized by workers before painter if renderThreads > 1
+  TileWorkers* workers = NULL;
+  unsigned int frame = 0;
+
+  bool empty() const { return !dirty.isValid(); }
+  void rasterize();
+  void clear();
+};
+
+// rasterizes frames on a separate thread so that main thread can handle input while previous frame is being
+//  painted; at most one frame is in flight - submit() waits for previous frame to finish before recording
+//  next one; renderFn is called on render thread and must rasterize the frame (and present it if needed)
+class RenderThread
+{
+public:
+  RenderThread(const std::function<void(DeferredFrame*)>& fn = NULL);
+  ~RenderThread();
+  bool submit(SvgGui* gui, Painter* painter);
+  void wait();
+
+  std::function<void(DeferredFrame*)> renderFn;
+
+private:
+  void run();
+
+  DeferredFrame frame;
+  std::thread thread;
+  Semaphore frameReady;
+  Semaphore frameDone;
+  bool inFlight = false;
+  bool quit = false;
+};
+
+// Only one SvgGui instance is supported at a time: state used by Widget methods which have no SvgGui pointer
+//  (layout-dirty registry, pending scrolls, layout arena used by layout.h allocator) and by drawing (frame
+//  counter, render cache and occlusion state, frame images, shadow cache) is file-static in svggui.cpp
 class SvgGui
 {
 public:
@@ -186,7 +408,7 @@ public:
 
   void showMenu(Widget* menu);
   void closeMenus(const Widget* parent_menu = NULL, bool closegroup = false);
-  void showContextMenu(Widget* menuext, const Point& p, const Widget* parent_menu = NULL, bool make_pressed = true);
+  void showContextMenu(AbsPosWidget* menuext, const Point& p, const Widget* parent_menu = NULL, bool make_pressed = true);
   //bool isInCurrMenuTree(Widget* menu) { isDescendant(menu, getPressedGroupContainer(menuStack.front())); }
 
   void onHideWidget(Widget* widget);
@@ -197,16 +419,26 @@ public:
   void layoutWidget(Widget* contents, const Rect& bbox);
   void layoutWindow(Window* win, const Rect& bbox);
   void layoutAbsPosWidget(AbsPosWidget* ext);
-  Rect layoutAndDraw(Painter* painter);
+  Rect layoutAndDraw(Painter* painter, std::vector<Rect>* dirtyRects = NULL);
+  bool recordFrame(Painter* painter, DeferredFrame* df);
+  // frame scheduling: needsFrame() is true if layoutAndDraw() has anything to do; nextDeadline() is the time
+  //  at which processTimers() or layoutAndDraw() should next be called (frames are limited to one per
+  //  frameInterval, so host can process all events received before deadline then draw once)
+  bool needsFrame() const;
+  Timestamp nextDeadline() const;
+  void requestFrame() { frameRequested = true; }
+  bool scrollPixels(Widget* viewport, Widget* contents, Point dr);
 
   Window* windowfromSDLID(Uint32 id);
   Widget* widgetAt(Window* win, Point p);
   Rect getScreenRect() const { return windows.empty() ? Rect() : windows.front()->winBounds(); }
   bool processTimers();
   bool sdlEvent(SDL_Event* event);
+  bool flushMotion();
   bool sendEventFilt(Window* win, Widget* widget, SDL_Event* event);
   bool sendEvent(Window* win, Widget* widget, SDL_Event* event);
   bool sdlTouchEvent(SDL_Event* event);
+  void touchToWindowCoords(SDL_Event* event, const Window* win);
   bool sdlMouseEvent(SDL_Event* event);
   bool sdlWindowEvent(SDL_Event* event);
   void updateGestures(SDL_Event* event);
@@ -244,6 +476,11 @@ public:
   Widget* eventWidget = NULL;
   SDL_Event* currSDLEvent = NULL;
   SDL_Event pressEvent;
+  // if coalesceMotion is set, consecutive motion events for the same pointer are held until another event is
+  //  received (or layoutAndDraw() is called) and only the last is sent; while it is being processed,
+  //  motionHistory holds the earlier samples, converted to SDL_FINGERMOTION events in window coords
+  bool coalesceMotion = false;
+  std::vector<SDL_Event> motionHistory;
 
   std::unique_ptr<std::thread> timerThread;
   Semaphore timerSem;
@@ -253,9 +490,28 @@ public:
   // set this if entire screen needs to be repainted if anything dirty (e.g. when drawing directly to
   //  screen instead of intermediate framebuffer) - if nothing dirty, user can just call endFrame() again
   bool fullRedraw = false;
+  // keep layout items across frames so that only dirty subtrees are prepared again (and isolated subtrees
+  //  are laid out in place) instead of rebuilding layout for whole window
+  bool persistentLayout = false;
+  // max number of separate dirty rects drawn (each w/ its own clip rect) by layoutAndDraw; 1 to always
+  //  redraw the union of all dirty areas
+  size_t maxDirtyRects = 8;
+  // skip drawing nodes completely hidden by an opaque rect within the dirty rect being drawn
+  bool occlusionCulling = false;
+  // number of threads used to rasterize dirty region (split into horizontal bands) w/ software painter
+  int renderThreads = 1;
+  // min time between frames in msec (i.e. display refresh interval) for nextDeadline(); 0 for no limit
+  int frameInterval = 16;
+  Timestamp lastFrameTime = 0;
 
   static bool debugLayout;
   static bool debugDirty;
+  // log layout allocation stats after each frame; unlike debugLayout, this doesn't change how layout is done
+  static bool debugLayoutAllocs;
+  // only search for layout changes along paths to widgets registered with Widget::setLayoutDirty() (called
+  //  by Widget methods that change layout, including attribute changes) instead of all dirty nodes; nodes
+  //  changed directly (not through Widget) must call setLayoutDirty() on a containing Widget
+  static bool trackLayoutDirty;
 
   // Should we move outside SvgGui and add "UGUI_" prefix instead?
   enum EventTypes { TIMER=0x9001, LONG_PRESS, MULTITOUCH, ENTER, LEAVE, FOCUS_GAINED, FOCUS_LOST,
@@ -268,6 +524,13 @@ public:
 
 //protected:
   lay_context layoutCtx;
+  // contexts for sub-layouts (layoutWidget), with item buffers from layoutArena; released after layout
+  std::vector<lay_context> layoutPool;
+  LayoutArena layoutArena;
+  lay_context acquireLayoutContext();
+  void releaseLayoutContext(const lay_context& ctx) { layoutPool.push_back(ctx); }
+  void releaseLayoutPool();
+  int layoutDepth = 0;  // nesting of layoutWidget/Window/AbsPosWidget calls
 
   real inputScale = 1;
   real paintScale = 1;
@@ -282,9 +545,25 @@ public:
   Point flingV;
   Timer* longPressTimer = NULL;
   Rect closedWindowBounds;
+  Rect closedLayerBounds;  // bounds of hidden or moved composite layers
+  bool frameRequested = false;  // set by requestFrame() for changes not reflected in any node
+  std::vector<SDL_Event> pendingMotion;  // see coalesceMotion
+  SDL_Event* coalescedEvent = NULL;
+  // offscreen image of content beneath composite layers - see layoutAndDraw()
+  std::unique_ptr<Image> underlay;
+  std::unique_ptr<Painter> underlayPainter;
+  std::vector<SvgNode*> underlayNodes;
+  size_t underlayDims = 0;
+  real underlayScale = 0;
+  std::vector< std::unique_ptr<Painter> > tilePainters;  // see renderThreads
+  std::unique_ptr<TileWorkers> tileWorkers;
+  DeferredFrame* recordingFrame = NULL;  // set by recordFrame so tile painters are rasterized in rasterize()
+
+  bool shiftScrolledPixels(Painter* painter, Widget* viewport, Widget* contents, Point dr, std::vector<Rect>& dirty);
   std::vector<Widget*> filterWidgets;
   std::string windowXmlClass;  // class added to every window for theming, etc.
   std::shared_ptr<SvgCssStylesheet> windowStylesheet;
 };
 
 bool isLongPressOrRightClick(SDL_Event* event);
+void translateCachedBounds(SvgNode* node, const Point& dr);
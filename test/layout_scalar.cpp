@@ -0,0 +1,14 @@
+// layout.h with default (linked list) backend
+#include "layout_test.h"
+
+#define LAY_FLOAT 1
+#define LAY_IMPLEMENTATION
+namespace lay_scalar {
+#include "../layout.h"
+}
+
+void runLayoutScalar(const std::vector<LayoutTestItem>& items, LayoutTestResult* res)
+{
+  lay_scalar::lay_context ctx;
+  runLayoutTest(&ctx, items, res);
+}
@@ -0,0 +1,15 @@
+// layout.h with structure-of-arrays backend, using SSE2/NEON if available
+#include "layout_test.h"
+
+#define LAY_FLOAT 1
+#define LAY_SOA
+#define LAY_IMPLEMENTATION
+namespace lay_soa {
+#include "../layout.h"
+}
+
+void runLayoutSoa(const std::vector<LayoutTestItem>& items, LayoutTestResult* res)
+{
+  lay_soa::lay_context ctx;
+  runLayoutTest(&ctx, items, res);
+}
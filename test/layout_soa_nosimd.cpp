@@ -0,0 +1,16 @@
+// layout.h with structure-of-arrays backend, scalar loops only
+#include "layout_test.h"
+
+#define LAY_FLOAT 1
+#define LAY_SOA
+#define LAY_NO_SIMD
+#define LAY_IMPLEMENTATION
+namespace lay_soa_nosimd {
+#include "../layout.h"
+}
+
+void runLayoutSoaNoSimd(const std::vector<LayoutTestItem>& items, LayoutTestResult* res)
+{
+  lay_soa_nosimd::lay_context ctx;
+  runLayoutTest(&ctx, items, res);
+}
@@ -0,0 +1,76 @@
+// compare layout.h structure-of-arrays backend (with and without SIMD) against default backend on random trees
+// usage: layout_test [ntrees [seed]]
+
+#include <stdio.h>
+#include <algorithm>
+#include <random>
+#include "layout_test.h"
+
+// flag values from layout.h (not included here since it is only built inside backend namespaces)
+enum { ROW = 0x002, COLUMN = 0x003, WRAP = 0x004, START = 0x008, END = 0x010, JUSTIFY = 0x018,
+    LEFT = 0x020, TOP = 0x040, RIGHT = 0x080, BOTTOM = 0x100, BREAK = 0x200 };
+
+static std::vector<LayoutTestItem> randomTree(std::mt19937& rng)
+{
+  auto randint = [&](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+  // mix of whole and fractional values; zero size means size is calculated from children
+  auto randlen = [&](int hi) {
+    int r = randint(0, 3);
+    return r == 0 ? 0.0f : r == 1 ? float(randint(1, hi)) : std::uniform_real_distribution<float>(0, hi)(rng);
+  };
+  static const uint32_t models[] = { 0, ROW, COLUMN, ROW | WRAP, COLUMN | WRAP };
+  static const uint32_t justify[] = { 0, START, END, JUSTIFY };
+
+  std::vector<LayoutTestItem> items;
+  int nitems = randint(1, 200);
+  for(int ii = 0; ii < nitems; ++ii) {
+    LayoutTestItem item;
+    // prefer recent items as parent to get deeper trees; some parents get many children to cover 4-wide loops
+    item.parent = ii == 0 ? -1 : randint(0, 3) == 0 ? randint(0, ii - 1) : randint(std::max(0, ii - 8), ii - 1);
+    item.contain = models[randint(0, 4)] | justify[randint(0, 3)];
+    item.behave = ii == 0 ? 0 : uint32_t(randint(0, 15)) << 5;  // any combination of LEFT, TOP, RIGHT, BOTTOM
+    if(randint(0, 15) == 0)
+      item.behave |= BREAK;
+    item.size[0] = ii == 0 ? float(randint(100, 1000)) : randlen(120);
+    item.size[1] = ii == 0 ? float(randint(100, 1000)) : randlen(120);
+    for(int jj = 0; jj < 4; ++jj)
+      item.margins[jj] = randint(0, 1) ? 0 : randlen(16);
+    items.push_back(item);
+  }
+  return items;
+}
+
+static bool compareResults(const char* name, const LayoutTestResult& ref, const LayoutTestResult& res, int tree)
+{
+  for(size_t ii = 0; ii < ref.flags.size(); ++ii) {
+    const float* a = &ref.rects[4*ii];
+    const float* b = &res.rects[4*ii];
+    if(a[0] != b[0] || a[1] != b[1] || a[2] != b[2] || a[3] != b[3] || ref.flags[ii] != res.flags[ii]) {
+      fprintf(stderr, "%s: tree %d item %d: expected %g %g %g %g flags 0x%x, got %g %g %g %g flags 0x%x\n",
+          name, tree, int(ii), a[0], a[1], a[2], a[3], ref.flags[ii], b[0], b[1], b[2], b[3], res.flags[ii]);
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  int ntrees = argc > 1 ? atoi(argv[1]) : 3000;
+  unsigned int seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+  std::mt19937 rng(seed);
+  int failures = 0;
+  for(int ii = 0; ii < ntrees; ++ii) {
+    std::vector<LayoutTestItem> items = randomTree(rng);
+    LayoutTestResult ref, soa, nosimd;
+    runLayoutScalar(items, &ref);
+    runLayoutSoa(items, &soa);
+    runLayoutSoaNoSimd(items, &nosimd);
+    if(!compareResults("LAY_SOA", ref, soa, ii))
+      ++failures;
+    if(!compareResults("LAY_SOA + LAY_NO_SIMD", ref, nosimd, ii))
+      ++failures;
+  }
+  printf("layout_test: %d trees (seed %u), %d failures\n", ntrees, seed, failures);
+  return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+// layout.h is built several times with different backends (see layout_scalar.cpp, layout_soa.cpp), each
+//  wrapped in its own namespace; headers it includes are included here first so their contents end up in the
+//  global namespace
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+#include <vector>
+
+// item of test tree; parent < index of item, so items can be created in order
+struct LayoutTestItem
+{
+  int parent;  // -1 for root
+  uint32_t contain;
+  uint32_t behave;
+  float size[2];
+  float margins[4];
+};
+
+// results of laying out a test tree: 4 rect components and the flags (incl. LAY_BREAK set by wrapping) per item
+struct LayoutTestResult
+{
+  std::vector<float> rects;
+  std::vector<uint32_t> flags;
+};
+
+// build tree in ctx (namespace of context type is found by ADL), run layout, and copy out results; tree is
+//  built and run twice, the second time in the same context after lay_reset_context(), to cover reuse
+template<class Context>
+void runLayoutTest(Context* ctx, const std::vector<LayoutTestItem>& items, LayoutTestResult* res)
+{
+  lay_init_context(ctx);
+  for(int pass = 0; pass < 2; ++pass) {
+    lay_reset_context(ctx);
+    for(const LayoutTestItem& item : items) {
+      auto id = lay_item(ctx);
+      lay_set_contain(ctx, id, item.contain);
+      lay_set_behave(ctx, id, item.behave);
+      lay_set_size_xy(ctx, id, item.size[0], item.size[1]);
+      lay_set_margins_ltrb(ctx, id, item.margins[0], item.margins[1], item.margins[2], item.margins[3]);
+      if(item.parent >= 0)
+        lay_insert(ctx, item.parent, id);
+    }
+    lay_run_context(ctx);
+  }
+  res->rects.resize(items.size()*4);
+  res->flags.resize(items.size());
+  for(size_t ii = 0; ii < items.size(); ++ii) {
+    auto r = lay_get_rect(ctx, ii);
+    for(int jj = 0; jj < 4; ++jj)
+      res->rects[4*ii + jj] = r[jj];
+    res->flags[ii] = lay_get_item(ctx, ii)->flags;
+  }
+  lay_destroy_context(ctx);
+}
+
+void runLayoutScalar(const std::vector<LayoutTestItem>& items, LayoutTestResult* res);
+void runLayoutSoa(const std::vector<LayoutTestItem>& items, LayoutTestResult* res);
+void runLayoutSoaNoSimd(const std::vector<LayoutTestItem>& items, LayoutTestResult* res);
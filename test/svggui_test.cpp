@@ -0,0 +1,164 @@
+// SvgGui tests - windows are drawn with the software painter to an offscreen image, and SDL's dummy video
+//  driver is used, so no display is needed
+// usage: svggui_test [seed]
+
+#include <stdio.h>
+#include <random>
+#include "usvg/svgpainter.h"
+#include "usvg/svgparser.h"
+#include "ugui/svggui.h"
+#include "ugui/widgets.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { if(!(cond)) { \
+  fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);  ++failures; } } while(0)
+
+static const int screenW = 800, screenH = 600;
+
+static int randint(std::mt19937& rng, int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); }
+
+// random mix of rects and groups, some of which are widgets (class "w"), and nested <svg> viewports whose
+//  contents mostly extend outside them (so hit testing must honor viewport clipping)
+static void randomContent(std::mt19937& rng, std::string& svg, int depth)
+{
+  int n = randint(rng, 1, depth > 0 ? 4 : 10);
+  for(int ii = 0; ii < n; ++ii) {
+    const char* cls = randint(rng, 0, 3) ? " class='w'" : "";
+    int x = randint(rng, -50, screenW), y = randint(rng, -50, screenH);
+    int w = randint(rng, 1, 300), h = randint(rng, 1, 300);
+    int type = depth < 3 ? randint(rng, 0, 2) : 0;
+    if(type == 0)
+      svg += fstring("<rect%s x='%d' y='%d' width='%d' height='%d' fill='#808080'/>", cls, x, y, w, h);
+    else if(type == 1) {
+      svg += fstring("<g%s>", cls);
+      randomContent(rng, svg, depth + 1);
+      svg += "</g>";
+    }
+    else {
+      svg += fstring("<svg%s x='%d' y='%d' width='%d' height='%d'>", cls, x, y, w, h);
+      randomContent(rng, svg, depth + 1);
+      svg += "</svg>";
+    }
+  }
+}
+
+static Window* createTestWindow(const char* svg, SDL_Window* sdlWin)
+{
+  Window* win = new Window(createWindowNode(svg));
+  for(SvgNode* node : win->containerNode()->select(".w"))
+    new Widget(node);
+  win->sdlWindow = sdlWin;
+  return win;
+}
+
+static void deleteTestWindow(SvgGui* gui, Window* win)
+{
+  gui->closeWindow(win);
+  win->sdlWindow = NULL;  // shared by all test windows
+  delete win;
+}
+
+// widgetAt() (which uses HitTestGrid) must return the same widget as searching the whole window with nodeAt()
+static void testHitTestGrid(SvgGui* gui, SDL_Window* sdlWin, Painter* painter, std::mt19937& rng)
+{
+  std::uniform_real_distribution<real> randx(0, screenW), randy(0, screenH);
+  for(int trial = 0; trial < 200; ++trial) {
+    std::string svg = "<svg class='window' layout='box'><g>";
+    randomContent(rng, svg, 0);
+    svg += "</g></svg>";
+    Window* win = createTestWindow(svg.c_str(), sdlWin);
+    gui->showWindow(win, NULL);
+    gui->layoutAndDraw(painter);
+    for(int ii = 0; ii < 1000; ++ii) {
+      Point p(randx(rng), randy(rng));
+      SvgNode* node = win->containerNode()->nodeAt(p, false);
+      while(node && !node->hasExt())
+        node = node->parent();
+      Widget* expected = node ? static_cast<Widget*>(node->ext()) : NULL;
+      Widget* hit = gui->widgetAt(win, p);
+      if(hit != expected) {
+        fprintf(stderr, "hit test trial %d: widgetAt(%g, %g) returned %s, expected %s\n", trial, p.x, p.y,
+            hit ? SvgNode::nodePath(hit->node).c_str() : "NULL",
+            expected ? SvgNode::nodePath(expected->node).c_str() : "NULL");
+        ++failures;
+        break;
+      }
+    }
+    CHECK(win->hitGrid);  // grid was actually used
+    deleteTestWindow(gui, win);
+  }
+}
+
+// after layoutAndDraw(), needsFrame() must be false so host can wait for events - including when changes are
+//  pending in a window hidden beneath one covering the screen, which aren't laid out until it is exposed
+static void testNeedsFrame(SvgGui* gui, SDL_Window* sdlWin, Painter* painter)
+{
+  const char* svg = "<svg class='window' layout='box'><rect class='w' width='100' height='100'/></svg>";
+  Window* win = createTestWindow(svg, sdlWin);
+  Widget* w = static_cast<Widget*>(win->containerNode()->selectFirst(".w")->ext());
+  gui->showWindow(win, NULL);
+  CHECK(gui->needsFrame());
+  gui->layoutAndDraw(painter);
+  CHECK(!gui->needsFrame());
+
+  w->setMargins(10);
+  CHECK(gui->needsFrame());
+  gui->layoutAndDraw(painter);
+  CHECK(!gui->needsFrame());
+
+  Window* modal = createTestWindow("<svg class='window' layout='box'></svg>", NULL);
+  modal->setWinBounds(win->winBounds());
+  gui->showModal(modal, win);
+  CHECK(gui->needsFrame());
+  gui->layoutAndDraw(painter);
+  CHECK(!gui->needsFrame());
+
+  w->setMargins(20);
+  gui->layoutAndDraw(painter);
+  CHECK(!gui->needsFrame());
+  CHECK(win->node->m_dirty != SvgNode::NOT_DIRTY);  // still pending
+
+  gui->closeWindow(modal);
+  delete modal;
+  CHECK(gui->needsFrame());
+  gui->layoutAndDraw(painter);
+  CHECK(!gui->needsFrame());
+  CHECK(win->node->m_dirty == SvgNode::NOT_DIRTY);
+
+  deleteTestWindow(gui, win);
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned int seed = argc > 1 ? strtoul(argv[1], NULL, 10) : 1;
+  std::mt19937 rng(seed);
+
+  SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+  if(SDL_Init(SDL_INIT_VIDEO) != 0) { fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError()); return -1; }
+  SDL_Window* sdlWin = SDL_CreateWindow("svggui_test", 0, 0, screenW, screenH, 0);
+  if(!sdlWin) { fprintf(stderr, "SDL_CreateWindow failed: %s\n", SDL_GetError()); return -1; }
+
+  Painter boundsPainter(Painter::PAINT_NULL);
+  SvgPainter boundsCalc(&boundsPainter);
+  SvgDocument::sharedBoundsCalc = &boundsCalc;
+  setGuiResources(SvgParser().parseString("<svg xmlns='http://www.w3.org/2000/svg'><defs/></svg>"));
+
+  Image image(screenW, screenH);
+  Painter painter(Painter::PAINT_SW, &image);
+  painter.deviceRect = Rect::wh(screenW, screenH);
+  {
+    SvgGui gui;
+    testHitTestGrid(&gui, sdlWin, &painter, rng);
+  }
+  for(bool track : {false, true}) {
+    SvgGui::trackLayoutDirty = track;
+    SvgGui gui;
+    testNeedsFrame(&gui, sdlWin, &painter);
+  }
+
+  SDL_DestroyWindow(sdlWin);
+  SDL_Quit();
+  printf("svggui_test: seed %u, %d failures\n", seed, failures);
+  return failures > 0 ? 1 : 0;
+}
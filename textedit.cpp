@@ -293,13 +293,13 @@ void TextEdit::showMenu(SvgGui* gui)
   ctxPaste->setVisible(!isReadOnly() && SDL_HasClipboardText());
   Rect menubounds = contextMenu->node->bounds();
   real w = std::max(100.0, menubounds.width());
-  gui->showContextMenu(contextMenu, Point(b.center().x - w/2, b.bottom + 30), NULL, false);
+  real x = b.center().x - w/2;
+  gui->showContextMenu(contextMenu, Point(x, b.bottom + 30), NULL, false);
   // place menu above text if room
   real y = b.top - 10;  //- menubounds.height()
   if(y > 0) {
     Rect pbounds = contextMenu->parent()->node->bounds();
-    contextMenu->node->removeAttr("top");
-    contextMenu->node->setAttribute("bottom", std::to_string(pbounds.bottom - y).c_str());
+    contextMenu->setOffsets(x - pbounds.left, NaN, NaN, pbounds.bottom - y);
   }
 }
 
@@ -491,6 +491,12 @@ void TextEdit::doUpdate()
   int selmax = std::max(stbState.select_start, stbState.select_end);
   bool selChanged = selStart != stbState.select_start || selEnd != stbState.select_end;
   bool hasOrHadSel = selStart != selEnd || stbState.select_start != stbState.select_end;
+  // text, tspans, and selection rect nodes are modified directly, so register for layout check (not needed
+  //  for LAYOUT_TEXT_CHANGE, which comes from onApplyLayout)
+  if(textChanged > LAYOUT_TEXT_CHANGE || selChanged) {
+    bumpLayoutGen();
+    setLayoutDirty();
+  }
   // keep select_start/_end valid even when no selection present (stb_textedit does not always do so)
   if(stbState.select_start == stbState.select_end) {
     stbState.select_start = stbState.cursor;
@@ -575,7 +581,7 @@ void TextEdit::doUpdate()
       scrollX += shpos - width;
       shpos = width;
     }
-    selStartHandle->node->setAttribute("left", std::to_string(shpos - 2).c_str());
+    selStartHandle->setOffsets(shpos - 2, SvgLength(100, SvgLength::PERCENT));  // top=100% as in template
 
     // cursor/end handle
     real pos0 = stbState.cursor > 0 ? glyphPos.at(stbState.cursor - 1).right : 0;
@@ -602,7 +608,7 @@ void TextEdit::doUpdate()
       cursorHandle->setVisible(false);
     else if(cursorMoved && stbState.cursor < int(glyphPos.size()))  //&& cursor->isVisible())
       cursorHandle->setVisible(true);
-    cursorHandle->node->setAttribute("left", std::to_string(hpos - 2).c_str());
+    cursorHandle->setOffsets(hpos - 2, SvgLength(100, SvgLength::PERCENT));
   }
 
   // menu center aligned w/ center of visible part of selection (typical behavior on Android and iOS)
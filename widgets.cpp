@@ -156,7 +156,7 @@ void setupFocusable(Widget* widget)
     else if(event->type == SvgGui::FOCUS_LOST)
       widget->node->removeClass("focused");
     return false;  // continue to next event handler
-  });
+  }, Widget::FOCUS_EVENTS);
 }
 
 // Note: menubar now implemented as separate class which adds an additional handler to each button
@@ -203,7 +203,7 @@ Button::Button(SvgNode* n) : Widget(n), mMenu(NULL), m_checked(false)
     else
       return false;
     return true;
-  });
+  }, HOVER_EVENTS | PRESS_EVENTS | STATE_EVENTS | KEY_EVENTS);
 }
 
 void Button::setMenu(Menu* m)
@@ -267,7 +267,7 @@ void setupMenuItem(Button* btn)
     else if(event->type == SDL_FINGERUP && !btn->mMenu)
       gui->closeMenus();  // close all menus if item clicked
     return false;  // continue to Button handler
-  });
+  }, Widget::HOVER_EVENTS | Widget::PRESS_EVENTS);
 }
 
 Button* createMenuItem(const char* title, const SvgNode* icon)
@@ -536,19 +536,21 @@ void setupTooltip(Widget* target, const char* tiptext, int align)
     Tooltips::inst->setup(target, tiptext, align);
 }
 
-void Tooltips::show(Widget* tooltip, Point p, int align)
+void Tooltips::show(AbsPosWidget* tooltip, Point p, int align)
 {
   Rect parentBounds = tooltip->node->parent()->bounds();
   real dx = align & LEFT ? 0 : align & RIGHT ? parentBounds.width() : p.x - parentBounds.left;
   real dy = align & TOP ? 0 : align & BOTTOM ? parentBounds.height() : p.y - parentBounds.top;
-  tooltip->node->setAttribute("left", fstring("%g", dx + offset.x).c_str());
-  tooltip->node->setAttribute(align & ABOVE ? "bottom" : "top", fstring("%g", dy + offset.y).c_str());
+  if(align & ABOVE)
+    tooltip->setOffsets(dx + offset.x, NaN, NaN, dy + offset.y);
+  else
+    tooltip->setOffsets(dx + offset.x, dy + offset.y);
   tooltip->setVisible(true);
 }
 
 void Tooltips::setup(Widget* target, const char* tiptext, int align)
 {
-  Widget* tooltip = new AbsPosWidget(widgetNode("#tooltip"));
+  AbsPosWidget* tooltip = new AbsPosWidget(widgetNode("#tooltip"));
   SvgNode* textNode = tiptext[0] == '<' ? loadSVGFragment(tiptext) : createTextNode(tiptext);
   textNode->setAttribute("margin", "3");
   tooltip->containerNode()->addChild(textNode);
@@ -584,7 +586,7 @@ void Tooltips::setup(Widget* target, const char* tiptext, int align)
       }
     }
     return false;  // don't swallow event
-  });
+  }, Widget::HOVER_EVENTS | Widget::PRESS_EVENTS);
 }
 
 CheckBox::CheckBox(SvgNode* n, bool _checked) : Button(n)
@@ -647,6 +649,8 @@ void setMinWidth(Widget* widget, real w, const char* sel)
   if(node && node->type() == SvgNode::RECT) {
     SvgRect* rectNode = static_cast<SvgRect*>(node);
     rectNode->setRect(Rect::wh(w, rectNode->getRect().height()));
+    widget->bumpLayoutGen();
+    widget->setLayoutDirty();
   }
 }
 
@@ -672,6 +676,8 @@ ComboBox::ComboBox(SvgNode* n, const std::vector<std::string>& _items) : Widget(
       SvgRect* rectNode = static_cast<SvgRect*>(minwidthnode);
       real sx = node->bounds().width()/rectNode->bounds().width();
       rectNode->setRect(Rect::wh(sx*rectNode->getRect().width(), rectNode->getRect().height()));
+      bumpLayoutGen();
+      setLayoutDirty();
     }
   };
 
@@ -955,6 +961,14 @@ void Splitter::setSplitSize(real size)
   real w = horz ? currSize * r0.width()/r1.width() : r0.width();  // size - handle.width()/2
   real h = horz ? r0.height() : currSize * r0.height()/r1.height();  // size - handle.height()/2
   sizingRectNode->setRect(Rect::ltwh(r0.left, r0.top, w, h));
+  // node is changed directly, so register nearest widget for layout check
+  for(SvgNode* n = sizingRectNode; n; n = n->parent()) {
+    if(n->hasExt()) {
+      static_cast<Widget*>(n->ext())->bumpLayoutGen();
+      static_cast<Widget*>(n->ext())->setLayoutDirty();
+      break;
+    }
+  }
   if(onSplitChanged)
     onSplitChanged(currSize);
 }
@@ -1219,6 +1233,7 @@ ScrollWidget::ScrollWidget(SvgDocument* doc, Widget* _contents) : Widget(doc), c
       bool cvfit = (contents->layBehave & LAY_VFILL) == LAY_VFILL;
       window()->gui()->layoutWidget(contents, Rect::wh(chfit ? dest.width() : 0, cvfit ? dest.height() : 0));
       contents->setLayoutTransform(Transform2D().translate(-scrollX, -scrollY) * contents->layoutTransform());
+      renderedScroll = Point(scrollX, scrollY);
       setLayoutTransform(tf);
     }
     // if contents were laid out, bbox may have changed ... should src not be passed to onApplyLayout?
@@ -1246,6 +1261,7 @@ ScrollWidget::ScrollWidget(SvgDocument* doc, Widget* _contents) : Widget(doc), c
       Rect bbox = contents->node->bounds();
       scrollX = scrx; scrollY = scry;  // contents layout w/o bounds will clear scrollX and scrollY
       contents->setLayoutTransform(Transform2D().translate(-scrollX, -scrollY) * contents->layoutTransform());
+      renderedScroll = Point(scrollX, scrollY);
       return Rect::wh(hfit ? bbox.width() : 0, vfit ? bbox.height() : 0);
     }
     else {
@@ -1328,17 +1344,6 @@ void ScrollWidget::scrollTo(Point r)
   flingV = Point(0, 0);
 }
 
-static void translateCachedBounds(SvgNode* node, const Point& dr)
-{
-  // if node has valid cached bounds, all children should as well, so caller just needs to check top-level node
-  node->m_cachedBounds.translate(dr);
-  auto* cnode = node->asContainerNode();
-  if(cnode) {
-    for(SvgNode* child : cnode->children())
-      translateCachedBounds(child, dr);
-  }
-}
-
 void ScrollWidget::setScrollPos(Point r)
 {
   if(!scrollLimits.isValid())
@@ -1350,17 +1355,27 @@ void ScrollWidget::setScrollPos(Point r)
 #ifdef DEBUG_CACHED_BOUNDS
   contents->setLayoutTransform(Transform2D::translating(scrollX-newx, scrollY-newy) * contents->layoutTransform());
 #else
-  // prevent recalculation of bounds or repeat of layout
-  Point dr(scrollX-newx, scrollY-newy);
-  contents->m_layoutTransform = Transform2D::translating(dr) * contents->m_layoutTransform;
-  if(contents->node->cachedBounds().isValid())
-    translateCachedBounds(contents->node, dr);
-  contents->node->setDirty(SvgNode::PIXELS_DIRTY);
-  real dy = (yHandle->node->bounds().height() - node->bounds().height())*dr.y/staticLimits.bottom;
-  yHandle->m_layoutTransform = Transform2D::translating(0, dy) * yHandle->m_layoutTransform;
-  if(yHandle->node->cachedBounds().isValid())
-    translateCachedBounds(yHandle->node, Point(0, dy));
-  yHandle->node->setDirty(SvgNode::PIXELS_DIRTY);
+  // contents are offset by scroll position rounded to device pixels, so that previously rendered contents can
+  //  be shifted instead of redrawn (see SvgGui::scrollPixels)
+  SvgGui* gui = blitScroll && window() ? window()->gui() : NULL;
+  Point offset = gui ? Point(std::round(newx*gui->paintScale), std::round(newy*gui->paintScale))/gui->paintScale
+      : Point(newx, newy);
+  // prevent recalculation of bounds or repeat of layout - unlike setLayoutTransform(), we use PIXELS_DIRTY
+  //  since bounds of the ScrollWidget itself do not change
+  Point dr = renderedScroll - offset;
+  if(dr != Point(0, 0)) {
+    contents->m_layoutTransform = Transform2D::translating(dr) * contents->m_layoutTransform;
+    if(!gui || !gui->scrollPixels(this, contents, dr))
+      contents->node->setDirty(SvgNode::PIXELS_DIRTY);
+    if(contents->node->cachedBounds().isValid())
+      translateCachedBounds(contents->node, dr);
+    real dy = (yHandle->node->bounds().height() - node->bounds().height())*dr.y/staticLimits.bottom;
+    yHandle->m_layoutTransform = Transform2D::translating(0, dy) * yHandle->m_layoutTransform;
+    if(yHandle->node->cachedBounds().isValid())
+      translateCachedBounds(yHandle->node, Point(0, dy));
+    yHandle->node->setDirty(SvgNode::PIXELS_DIRTY);
+  }
+  renderedScroll = offset;
 #endif
   scrollX = newx;
   scrollY = newy;
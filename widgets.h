@@ -115,7 +115,7 @@ class TextBox : public Widget
 {
 public:
   TextBox(SvgNode* n);
-  void setText(const char* s) override { textNode->setText(s); }
+  void setText(const char* s) override { textNode->setText(s);  bumpLayoutGen();  setLayoutDirty(); }
   virtual bool isEditable() const { return false; }
   virtual std::string text() const { return textNode->text(); }
 
@@ -237,6 +237,8 @@ public:
   Rect staticLimits;
 
   std::function<void()> onScroll;
+  // shift rendered contents when scrolling instead of redrawing if possible (see SvgGui::scrollPixels)
+  bool blitScroll = true;
 
 private:
   void setScrollPos(Point r);
@@ -248,6 +250,7 @@ private:
   real minFlingV = 200*1E-3;  // pix per ms
   real flingTimerMs = 32;  // ~30fps
   real overScroll = 0;
+  Point renderedScroll;  // scroll offset applied to contents
   Point flingV;
 
   Point initialPos;
@@ -293,7 +296,7 @@ private:
   Timer* timer = NULL;
   unsigned int hideTime = 0;
 
-  void show(Widget* tooltip, Point p, int align);
+  void show(AbsPosWidget* tooltip, Point p, int align);
 };
 
 class CustomWidget : public Widget